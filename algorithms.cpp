@@ -5,16 +5,12 @@
 
 using namespace tuo;
 
-inline bool try_improve_deck(Deck* d1, unsigned from_slot, unsigned to_slot, const Card* card_candidate,
-		const Card*& best_commander, const Card*& best_alpha_dominion, std::vector<const Card*>& best_cards,
-		FinalResults<long double>& best_score, unsigned& best_gap, std::string& best_deck,
-		std::unordered_map<std::string, EvaluatedResults>& evaluated_decks, EvaluatedResults& zero_results,
-		unsigned long& skipped_simulations, Process& proc, bool print=true)
+// d1 <- best deck adjusted by the move; false if the move is not possible or the deck gets no closer to the requirement
+inline bool setup_improved_deck(Deck* d1, unsigned from_slot, unsigned to_slot, const Card* card_candidate,
+		const Card* best_commander, const Card* best_alpha_dominion, const std::vector<const Card*>& best_cards,
+		unsigned best_gap, RandomEngine& re, unsigned& deck_cost,
+		std::vector<std::pair<signed, const Card *>>& cards_out, std::vector<std::pair<signed, const Card *>>& cards_in, unsigned& new_gap)
 {
-	unsigned deck_cost(0);
-	std::vector<std::pair<signed, const Card *>> cards_out, cards_in;
-	std::mt19937& re = proc.threads_data[0]->re;
-
 	// setup best deck
 	d1->commander = best_commander;
 	d1->alpha_dominion = best_alpha_dominion;
@@ -25,38 +21,49 @@ inline bool try_improve_deck(Deck* d1, unsigned from_slot, unsigned to_slot, con
 	{ return false; }
 
 	// check gap
-	unsigned new_gap = check_requirement(d1, requirement
+	new_gap = check_requirement(d1, requirement
 #ifndef NQUEST
 			, quest
 #endif
 			);
-	if ((new_gap > 0) && (new_gap >= best_gap))
-	{ return false; }
-
-	// check previous simulations
-	auto && cur_deck = d1->hash();
-	auto && emplace_rv = evaluated_decks.insert({cur_deck, zero_results});
-	auto & prev_results = emplace_rv.first->second;
-	if (!emplace_rv.second)
-	{
-		skipped_simulations += prev_results.second;
-	}
+	return (new_gap == 0) || (new_gap < best_gap);
+}
 
-	// Evaluate new deck
-	auto compare_results = proc.compare(best_score.n_sims, prev_results, best_score);
+// a deck evaluated as compare_results (with gap new_gap) is better than the best deck
+inline bool improves_best_deck(const EvaluatedResults& compare_results, unsigned new_gap,
+		const FinalResults<long double>& best_score, unsigned best_gap, Process& proc)
+{
 	auto current_score = compute_score(compare_results, proc.factors);
+	// under common random numbers a deck stopped early is compared with the same battles of the best deck
+	auto best_points = proc.crn_incumbent_points(compare_results.second, best_score.points);
+	return new_gap < best_gap || current_score.points > best_points + min_increment_of_score;
+}
 
+// d1 (evaluated as compare_results) becomes the best deck if it is better
+inline bool accept_improved_deck(Deck* d1, const EvaluatedResults& compare_results, unsigned new_gap, unsigned deck_cost,
+		const std::vector<std::pair<signed, const Card *>>& cards_out, const std::vector<std::pair<signed, const Card *>>& cards_in,
+		const Card*& best_commander, const Card*& best_alpha_dominion, std::vector<const Card*>& best_cards,
+		FinalResults<long double>& best_score, unsigned& best_gap, std::string& best_deck,
+		Process& proc, bool print)
+{
 	// Is it better ?
-	if (new_gap < best_gap || current_score.points > best_score.points + min_increment_of_score)
+	if (improves_best_deck(compare_results, new_gap, best_score, best_gap, proc))
 	{
+		auto current_score = compute_score(compare_results, proc.factors);
+		auto && cur_deck = d1->hash();
 		// Then update best score/slot, print stuff
 		if(print)std::cout << "Deck improved: " << d1->hash() << ": " << card_slot_id_names(cards_out) << " -> " << card_slot_id_names(cards_in) << ": ";
 		best_gap = new_gap;
+		// a deck accepted early (sprt) keeps the battles budget of the next comparisons
+		auto n_sims = std::max(best_score.n_sims, current_score.n_sims);
 		best_score = current_score;
+		best_score.n_sims = n_sims;
 		best_deck = cur_deck;
 		best_commander = d1->commander;
 		best_alpha_dominion = d1->alpha_dominion;
 		best_cards = d1->cards;
+		if (proc.crn_incumbent)
+		{ proc.set_crn_incumbent(&compare_results); }
 		if(print)print_score_info(compare_results, proc.factors);
 		if(print)print_deck_inline(deck_cost, best_score, d1);
 		return true;
@@ -64,6 +71,173 @@ inline bool try_improve_deck(Deck* d1, unsigned from_slot, unsigned to_slot, con
 
 	return false;
 }
+
+inline bool try_improve_deck(Deck* d1, unsigned from_slot, unsigned to_slot, const Card* card_candidate,
+		const Card*& best_commander, const Card*& best_alpha_dominion, std::vector<const Card*>& best_cards,
+		FinalResults<long double>& best_score, unsigned& best_gap, std::string& best_deck,
+		std::unordered_map<std::string, EvaluatedResults>& evaluated_decks, EvaluatedResults& zero_results,
+		unsigned long& skipped_simulations, Process& proc, bool print=true)
+{
+	unsigned deck_cost(0), new_gap(0);
+	std::vector<std::pair<signed, const Card *>> cards_out, cards_in;
+	RandomEngine& re = proc.threads_data[0]->re;
+
+	if (!setup_improved_deck(d1, from_slot, to_slot, card_candidate, best_commander, best_alpha_dominion, best_cards,
+			best_gap, re, deck_cost, cards_out, cards_in, new_gap))
+	{ return false; }
+
+	// check previous simulations
+	auto && cur_deck = d1->hash();
+	auto && emplace_rv = evaluated_decks.insert({cur_deck, zero_results});
+	proc.count_evaluated_deck(evaluated_decks, *emplace_rv.first, !emplace_rv.second);
+	auto & prev_results = emplace_rv.first->second;
+	if (!emplace_rv.second)
+	{
+		skipped_simulations += prev_results.second;
+	}
+
+	// Evaluate new deck
+	auto & compare_results = proc.compare(best_score.n_sims, prev_results, best_score);
+	skipped_simulations += proc.take_sprt_skipped_simulations();
+
+	return accept_improved_deck(d1, compare_results, new_gap, deck_cost, cards_out, cards_in,
+			best_commander, best_alpha_dominion, best_cards, best_score, best_gap, best_deck, proc, print);
+}
+
+/*
+ * Speculative try_improve_deck() for several moves (card, to_slot) of from_slot: all of them are set up
+ * against the current best deck and simmed at once (see Process::evaluate_batch()), then the first one
+ * (in the given order) that improves the best deck is committed. The batch stops the moves after
+ * a move found improving the deck, as they cannot be committed anymore.
+ * Returns the index of the committed move, or moves.size() if none improved the deck.
+ */
+inline unsigned try_improve_deck_speculative(Deck* d1, unsigned from_slot, const std::vector<std::pair<const Card*, unsigned>>& moves,
+		const Card*& best_commander, const Card*& best_alpha_dominion, std::vector<const Card*>& best_cards,
+		FinalResults<long double>& best_score, unsigned& best_gap, std::string& best_deck,
+		std::unordered_map<std::string, EvaluatedResults>& evaluated_decks, EvaluatedResults& zero_results,
+		unsigned long& skipped_simulations, Process& proc, bool print=true)
+{
+	struct SpeculativeMove
+	{
+		unsigned index;
+		std::shared_ptr<Deck> deck;
+		unsigned deck_cost, new_gap;
+		std::vector<std::pair<signed, const Card *>> cards_out, cards_in;
+		EvaluatedResults* results;
+	};
+	std::vector<SpeculativeMove> speculative_moves;
+	std::vector<BatchCandidate> candidates;
+	std::vector<unsigned> candidate_moves; // index in speculative_moves of every candidate
+	std::vector<EvaluatedResults*> repeated_results;
+	RandomEngine& re = proc.threads_data[0]->re;
+	for (unsigned index(0); index < moves.size(); ++index)
+	{
+		SpeculativeMove move{index, nullptr, 0, 0, {}, {}, nullptr};
+		if (!setup_improved_deck(d1, from_slot, moves[index].second, moves[index].first, best_commander, best_alpha_dominion, best_cards,
+				best_gap, re, move.deck_cost, move.cards_out, move.cards_in, move.new_gap))
+		{ continue; }
+		move.deck.reset(d1->clone());
+		auto && emplace_rv = evaluated_decks.insert({d1->hash(), zero_results});
+		proc.count_evaluated_deck(evaluated_decks, *emplace_rv.first, !emplace_rv.second);
+		move.results = &emplace_rv.first->second;
+		if (std::find_if(speculative_moves.begin(), speculative_moves.end(),
+				[&move](const SpeculativeMove& other) { return other.results == move.results; }) != speculative_moves.end())
+		{
+			// the same deck again: simmed once, counted as skipped once simmed
+			repeated_results.push_back(move.results);
+		}
+		else
+		{
+			// check previous simulations
+			if (!emplace_rv.second)
+			{
+				skipped_simulations += move.results->second;
+			}
+			candidates.push_back({move.deck, move.results, &best_score});
+			candidate_moves.push_back(speculative_moves.size());
+		}
+		speculative_moves.emplace_back(std::move(move));
+	}
+
+	// Evaluate new decks (the same check as accept_improved_deck(), as nothing is committed meanwhile)
+	proc.evaluate_batch(candidates, best_score.n_sims, [&](unsigned candidate_index) {
+			const SpeculativeMove& move(speculative_moves[candidate_moves[candidate_index]]);
+			return improves_best_deck(*move.results, move.new_gap, best_score, best_gap, proc);
+		});
+	skipped_simulations += proc.take_sprt_skipped_simulations();
+	for (auto results: repeated_results)
+	{
+		skipped_simulations += results->second;
+	}
+
+	// commit the first improvement (the others are dropped: their results stay in evaluated_decks)
+	for (const SpeculativeMove& move: speculative_moves)
+	{
+		copy_deck(move.deck.get(), d1);
+		if (accept_improved_deck(d1, *move.results, move.new_gap, move.deck_cost, move.cards_out, move.cards_in,
+				best_commander, best_alpha_dominion, best_cards, best_score, best_gap, best_deck, proc, print))
+		{ return move.index; }
+	}
+	return moves.size();
+}
+//------------------------------------------------------------------------------
+/*
+ * Card candidate loop of from_slot with speculative moves: the next climb_speculative moves (card candidates
+ * in order, each to every slot of [to_slot_begin(card), to_slot_end(card)) but the void ones) are simmed at once
+ * by try_improve_deck_speculative(); after a commit it goes on with the move following the committed one.
+ * on_commit() is called after every commit (d1 is then the new best deck). Returns true if any move was committed.
+ */
+template<typename ToSlotBegin, typename ToSlotEnd, typename IsVoidMove, typename OnCommit>
+inline bool try_improve_deck_candidates_speculative(Deck* d1, unsigned from_slot, const std::vector<const Card*>& card_candidates,
+		ToSlotBegin to_slot_begin, ToSlotEnd to_slot_end, IsVoidMove is_void_move, OnCommit on_commit,
+		const Card*& best_commander, const Card*& best_alpha_dominion, std::vector<const Card*>& best_cards,
+		FinalResults<long double>& best_score, unsigned& best_gap, std::string& best_deck,
+		std::unordered_map<std::string, EvaluatedResults>& evaluated_decks, EvaluatedResults& zero_results,
+		unsigned long& skipped_simulations, Process& proc, bool print=true)
+{
+	bool improved(false);
+	for (unsigned c(0), to_slot(card_candidates.empty() ? 0 : to_slot_begin(card_candidates[0]));
+			c < card_candidates.size(); )
+	{
+		std::vector<std::pair<const Card*, unsigned>> moves;
+		std::vector<std::pair<unsigned, unsigned>> move_positions;
+		unsigned next_c(c), next_to_slot(to_slot);
+		while ((next_c < card_candidates.size()) && (moves.size() < climb_speculative))
+		{
+			const Card* card_candidate = card_candidates[next_c];
+			if (next_to_slot >= to_slot_end(card_candidate))
+			{
+				if (++ next_c < card_candidates.size())
+				{ next_to_slot = to_slot_begin(card_candidates[next_c]); }
+				continue;
+			}
+			if (!is_void_move(card_candidate, next_to_slot))
+			{
+				moves.emplace_back(card_candidate, next_to_slot);
+				move_positions.emplace_back(next_c, next_to_slot);
+			}
+			++ next_to_slot;
+		}
+		unsigned committed = try_improve_deck_speculative(d1, from_slot, moves,
+				best_commander, best_alpha_dominion, best_cards, best_score, best_gap, best_deck,
+				evaluated_decks, zero_results, skipped_simulations, proc, print);
+		if (committed < moves.size())
+		{
+			improved = true;
+			on_commit();
+			c = move_positions[committed].first;
+			to_slot = move_positions[committed].second + 1;
+		}
+		else
+		{
+			c = next_c;
+			to_slot = next_to_slot;
+		}
+		if (best_score.points - target_score > -1e-9)
+		{ break; }
+	}
+	return improved;
+}
 //------------------------------------------------------------------------------
 /*
  * Calc value of current set deck in d1 (proc.your_decks[0])
@@ -78,6 +252,7 @@ inline FinalResults<long double> fitness(Deck* d1,
 	auto && cur_deck = d1->hash();
 	//std::cout << "Deck hash: " << d1->hash() << " with ";
 	auto && emplace_rv = evaluated_decks.insert({cur_deck, zero_results});
+	proc.count_evaluated_deck(evaluated_decks, *emplace_rv.first, !emplace_rv.second);
 	auto & prev_results = emplace_rv.first->second;
 	if (!emplace_rv.second)
 	{
@@ -87,6 +262,7 @@ inline FinalResults<long double> fitness(Deck* d1,
 	// Evaluate new deck
 	if (compare) {
 		auto compare_results= proc.compare(best_score.n_sims, prev_results,best_score);
+		skipped_simulations += proc.take_sprt_skipped_simulations();
 		auto current_score = compute_score(compare_results, proc.factors);
 		return current_score;
 	}
@@ -103,6 +279,60 @@ inline FinalResults<long double> fitness(Deck* d1,
 	}
 }
 //------------------------------------------------------------------------------
+/*
+ * Calc values of several decks at once (see Process::evaluate_batch()):
+ * like fitness(d1 <- decks[i], compare) for every deck, but the battles of all of them are interleaved.
+ * With compare, every deck is compared with best_score as it is when the batch starts: a caller taking
+ * the decks in turn must check each score against its current best (a deck stopped early cannot beat
+ * that either, but the ones that do not stop may get more battles than compare() in turn would give them);
+ * genetic() does so.
+ */
+inline std::vector<FinalResults<long double>> batch_fitness(const std::vector<Deck*>& decks, Deck* d1,
+		FinalResults<long double>& best_score,
+		std::unordered_map<std::string, EvaluatedResults>& evaluated_decks, EvaluatedResults& zero_results,
+		unsigned long& skipped_simulations, Process& proc, bool compare = true)
+{
+	std::vector<BatchCandidate> candidates;
+	std::vector<EvaluatedResults*> deck_results, repeated_results;
+	for (Deck* deck: decks)
+	{
+		std::shared_ptr<Deck> candidate_deck(d1->clone());
+		copy_deck(deck, candidate_deck.get());
+		auto && emplace_rv = evaluated_decks.insert({candidate_deck->hash(), zero_results});
+		proc.count_evaluated_deck(evaluated_decks, *emplace_rv.first, !emplace_rv.second);
+		auto & prev_results = emplace_rv.first->second;
+		if (std::find(deck_results.begin(), deck_results.end(), &prev_results) != deck_results.end())
+		{
+			// the same deck again: simmed once, counted as skipped once simmed
+			repeated_results.push_back(&prev_results);
+		}
+		else
+		{
+			// check previous simulations
+			if (!emplace_rv.second)
+			{
+				skipped_simulations += prev_results.second;
+			}
+			candidates.push_back({candidate_deck, &prev_results, compare ? &best_score : nullptr});
+		}
+		deck_results.push_back(&prev_results);
+	}
+
+	// Evaluate new decks
+	proc.evaluate_batch(candidates, best_score.n_sims);
+	skipped_simulations += proc.take_sprt_skipped_simulations();
+	for (auto results: repeated_results)
+	{
+		skipped_simulations += results->second;
+	}
+	std::vector<FinalResults<long double>> scores;
+	for (auto results: deck_results)
+	{
+		scores.push_back(compute_score(*results, proc.factors));
+	}
+	return scores;
+}
+//------------------------------------------------------------------------------
 Deck* filter_best_deck(std::vector<Deck*> your_decks, Deck* d1,
 		FinalResults<long double>& best_score,
 		std::unordered_map<std::string, EvaluatedResults>& evaluated_decks, EvaluatedResults& zero_results,
@@ -143,6 +373,8 @@ FinalResults<long double> hill_climbing(unsigned num_min_iterations, unsigned nu
 
 	// use the best deck from all passed decks
 	copy_deck(filter_best_deck(your_decks, d1, best_score, evaluated_decks, zero_results, skipped_simulations, proc),d1);
+	// the next comparisons are paired with the best deck (common random numbers)
+	proc.set_crn_incumbent(use_crn ? &evaluated_decks[d1->hash()] : nullptr);
 
 	// update freezed_cards
 	freezed_cards = std::min<unsigned>(opt_freezed_cards, d1->cards.size());
@@ -152,13 +384,13 @@ FinalResults<long double> hill_climbing(unsigned num_min_iterations, unsigned nu
 	unsigned deck_cost = get_deck_cost(d1);
 	fund = std::max(fund, deck_cost);
 	print_deck_inline(deck_cost, best_score, d1);
-	std::mt19937& re = proc.threads_data[0]->re;
+	RandomEngine& re = proc.threads_data[0]->re;
 	unsigned best_gap = check_requirement(d1, requirement
 #ifndef NQUEST
 			, quest
 #endif
 			);
-	bool is_random = (d1->strategy == DeckStrategy::random) || (d1->strategy == DeckStrategy::flexible);
+	bool is_random = is_random_strategy(d1->strategy);
 	bool deck_has_been_improved = true;
 	std::vector<const Card*> commander_candidates;
 	std::vector<const Card*> alpha_dominion_candidates;
@@ -223,6 +455,7 @@ FinalResults<long double> hill_climbing(unsigned num_min_iterations, unsigned nu
 			d1->cards = best_cards;
 			auto evaluate_result = proc.evaluate(std::min(prev_results.second * iterations_multiplier, num_iterations), prev_results);
 			best_score = compute_score(evaluate_result, proc.factors);
+			proc.set_crn_incumbent(proc.crn_incumbent ? &prev_results : nullptr);
 			std::cout << "Results refined: ";
 			print_score_info(evaluate_result, proc.factors);
 			dead_slot = from_slot;
@@ -273,19 +506,37 @@ FinalResults<long double> hill_climbing(unsigned num_min_iterations, unsigned nu
 		// shuffle candidates
 		std::shuffle(card_candidates.begin(), card_candidates.end(), re);
 
+		// to_slot range of a card candidate and moves to skip (2 Omega -> 2 Omega, void -> void)
+		auto to_slot_begin = [&](const Card* card_candidate) -> unsigned {
+			return is_random ? from_slot : card_candidate ? freezed_cards : (best_cards.size() - 1);
+		};
+		auto to_slot_end = [&](const Card* card_candidate) -> unsigned {
+			return is_random ? (from_slot + 1) : (best_cards.size() + (from_slot < best_cards.size() ? 0 : 1));
+		};
+		auto is_void_move = [&](const Card* card_candidate, unsigned to_slot) -> bool {
+			return card_candidate ?
+				(from_slot < best_cards.size() && (from_slot == to_slot && card_candidate == best_cards[to_slot])) // 2 Omega -> 2 Omega
+				:
+				(from_slot == best_cards.size()); // void -> void
+		};
+
+		// << speculative card candidate loop >>
+		if (climb_speculative > 1)
+		{
+			deck_has_been_improved |= try_improve_deck_candidates_speculative(d1, from_slot, card_candidates,
+					to_slot_begin, to_slot_end, is_void_move, [](){},
+					best_commander, best_alpha_dominion, best_cards, best_score, best_gap, best_deck,
+					evaluated_decks, zero_results, skipped_simulations, proc);
+		}
+
 		// << card candidate loop >>
 		//for (const Card* card_candidate: card_candidates)
-		for (auto it = card_candidates.begin(); it != card_candidates.end();++it)
+		for (auto it = card_candidates.begin(); (climb_speculative <= 1) && (it != card_candidates.end()); ++it)
 		{
 			const Card* card_candidate = *it;
-			for (unsigned to_slot(is_random ? from_slot : card_candidate ? freezed_cards : (best_cards.size() - 1));
-					to_slot < (is_random ? (from_slot + 1) : (best_cards.size() + (from_slot < best_cards.size() ? 0 : 1)));
-					++ to_slot)
+			for (unsigned to_slot(to_slot_begin(card_candidate)); to_slot < to_slot_end(card_candidate); ++ to_slot)
 			{
-				if (card_candidate ?
-						(from_slot < best_cards.size() && (from_slot == to_slot && card_candidate == best_cards[to_slot])) // 2 Omega -> 2 Omega
-						:
-						(from_slot == best_cards.size())) // void -> void
+				if (is_void_move(card_candidate, to_slot))
 				{ continue; }
 				deck_has_been_improved |= try_improve_deck(d1, from_slot, to_slot, card_candidate,
 						best_commander, best_alpha_dominion, best_cards, best_score, best_gap, best_deck,
@@ -299,6 +550,7 @@ FinalResults<long double> hill_climbing(unsigned num_min_iterations, unsigned nu
 	d1->commander = best_commander;
 	d1->alpha_dominion = best_alpha_dominion;
 	d1->cards = best_cards;
+	proc.set_crn_incumbent(nullptr);
 	unsigned simulations = 0;
 	for (auto evaluation: evaluated_decks)
 	{ simulations += evaluation.second.second; }
@@ -352,14 +604,14 @@ FinalResults<long double> simulated_annealing(unsigned num_min_iterations, unsig
 	unsigned deck_cost = get_deck_cost(cur_deck);
 	fund = std::max(fund, deck_cost);
 	print_deck_inline(deck_cost, best_score, cur_deck);
-	std::mt19937& re = proc.threads_data[0]->re;
+	RandomEngine& re = proc.threads_data[0]->re;
 	unsigned cur_gap = check_requirement(cur_deck, requirement
 #ifndef NQUEST
 			, quest
 #endif
 			);
 
-	bool is_random = (cur_deck->strategy == DeckStrategy::random) || (cur_deck->strategy == DeckStrategy::flexible);
+	bool is_random = is_random_strategy(cur_deck->strategy);
 	std::vector<const Card*> all_candidates;
 
 	auto mixed_candidates = get_candidate_lists(proc);
@@ -493,7 +745,7 @@ FinalResults<long double> simulated_annealing(unsigned num_min_iterations, unsig
 
 
 
-void crossover(Deck* src1,Deck* src2, Deck* cur_deck, std::mt19937& re,unsigned best_gap,std::unordered_map<std::string, EvaluatedResults>& evaluated_decks)
+void crossover(Deck* src1,Deck* src2, Deck* cur_deck, RandomEngine& re,unsigned best_gap,std::unordered_map<std::string, EvaluatedResults>& evaluated_decks)
 {
 	cur_deck->commander = std::uniform_int_distribution<unsigned>(0, 1)(re)?src1->commander:src2->commander;
 	cur_deck->alpha_dominion = std::uniform_int_distribution<unsigned>(0, 1)(re)?src1->alpha_dominion:src2->alpha_dominion;
@@ -529,11 +781,11 @@ void crossover(Deck* src1,Deck* src2, Deck* cur_deck, std::mt19937& re,unsigned
 	if(!finished) copy_deck(std::uniform_int_distribution<unsigned>(0, 1)(re)?src1:src2,cur_deck);
 }
 
-void mutate(Deck* src, Deck* cur_deck, std::vector<const Card*> all_candidates, std::mt19937& re,unsigned best_gap,std::unordered_map<std::string, EvaluatedResults>& evaluated_decks)
+void mutate(Deck* src, Deck* cur_deck, std::vector<const Card*> all_candidates, RandomEngine& re,unsigned best_gap,std::unordered_map<std::string, EvaluatedResults>& evaluated_decks)
 {
 	copy_deck(src,cur_deck);
 
-	bool is_random = (cur_deck->strategy == DeckStrategy::random) || (cur_deck->strategy == DeckStrategy::flexible); //should be same for all decks from input!?
+	bool is_random = is_random_strategy(cur_deck->strategy); //should be same for all decks from input!?
 
 	unsigned deck_cost = 0;
 
@@ -635,7 +887,7 @@ FinalResults<long double> genetic_algorithm(unsigned num_min_iterations, unsigne
 	unsigned deck_cost = get_deck_cost(cur_deck);
 	fund = std::max(fund, deck_cost);
 	print_deck_inline(deck_cost, best_score, cur_deck);
-	std::mt19937& re = proc.threads_data[0]->re;
+	RandomEngine& re = proc.threads_data[0]->re;
 	unsigned cur_gap = check_requirement(cur_deck, requirement
 #ifndef NQUEST
 			, quest
@@ -698,11 +950,13 @@ FinalResults<long double> genetic_algorithm(unsigned num_min_iterations, unsigne
 		}
 		your_decks.push_back(nxt);
 	}
-	//sim pool
-	for( auto i_deck :your_decks)
+	//sim pool (at once: each deck is compared with the best score of the passed decks, then committed in turn)
+	auto pool_scores = batch_fitness(your_decks, cur_deck, best_score, evaluated_decks, zero_results, skipped_simulations, proc);
+	for( unsigned i = 0; i < your_decks.size(); ++i)
 	{
+		auto i_deck = your_decks[i];
 		copy_deck(i_deck,cur_deck);
-		cur_score = fitness(cur_deck, best_score, evaluated_decks, zero_results, skipped_simulations, proc,true);
+		cur_score = pool_scores[i];
 		pool.push_back(std::make_pair(i_deck,cur_score));
 		if(cur_score.points > best_score.points)
 		{
@@ -761,11 +1015,16 @@ FinalResults<long double> genetic_algorithm(unsigned num_min_iterations, unsigne
 				}
 			}
 		}
-		//calc fitness
+		//calc fitness (at once: each bred deck is compared with the best score of the previous generation,
+		//then committed in turn against the current best one, see batch_fitness())
+		std::vector<Deck*> bred_decks;
+		for (unsigned it = pool_keep; it < pool_size; it++)
+		{ bred_decks.push_back(pool[it].first); }
+		auto bred_scores = batch_fitness(bred_decks, cur_deck, best_score, evaluated_decks, zero_results, skipped_simulations, proc);
 		for (unsigned it = pool_keep; it < pool_size; it++)
 		{
 			copy_deck(pool[it].first,cur_deck);
-			cur_score = fitness(cur_deck, best_score, evaluated_decks, zero_results, skipped_simulations, proc,true);
+			cur_score = bred_scores[it - pool_keep];
 			pool[it].second = cur_score;
 			if(cur_score.points > best_score.points)
 			{
@@ -846,6 +1105,7 @@ void recursion(unsigned num_iterations, std::vector<unsigned> used, unsigned poo
 		encode_deck_ext_b64(ios,proc.your_decks[0]->fortress_cards);
 		auto hash = ios.str();
 		auto && emplace_rv = evaluated_decks.insert({hash,zero_results});
+		proc.count_evaluated_deck(evaluated_decks, *emplace_rv.first, !emplace_rv.second);
 		auto & prev_results = emplace_rv.first->second;
 		if(!emplace_rv.second)
 		{
@@ -958,7 +1218,7 @@ FinalResults<long double> beam_climb(unsigned num_min_iterations, unsigned num_i
 	unsigned deck_cost = get_deck_cost(cur_deck);
 	fund = std::max(fund, deck_cost);
 	print_deck_inline(deck_cost, best_score, cur_deck);
-	std::mt19937& re = proc.threads_data[0]->re;
+	RandomEngine& re = proc.threads_data[0]->re;
 	unsigned cur_gap = check_requirement(cur_deck, requirement
 #ifndef NQUEST
 			, quest
@@ -967,7 +1227,7 @@ FinalResults<long double> beam_climb(unsigned num_min_iterations, unsigned num_i
 
 	unsigned long skipped_simulations = 0;
 
-	bool is_random = (cur_deck->strategy == DeckStrategy::random) || (cur_deck->strategy == DeckStrategy::flexible);
+	bool is_random = is_random_strategy(cur_deck->strategy);
 	bool deck_has_been_improved = true;
 
 	std::vector<const Card*> commander_candidates;
@@ -1018,23 +1278,29 @@ FinalResults<long double> beam_climb(unsigned num_min_iterations, unsigned num_i
 	unsigned mod_permute = 10*9*8*7*6*5*4*3*2*1;
 	//FinalResults<long double> tmp_result;
 	FinalResults<long double> nil{0, 0, 0, 0, 0, 0, num_min_iterations};
-	//sim passed decks
-	for(auto ii : your_decks){
-			auto tdeck = ii->clone();
+	//sim passed decks (at once)
+	auto passed_scores = batch_fitness(your_decks,cur_deck,nil,evaluated_decks,zero_results,skipped_simulations,proc,false);
+	for(unsigned ii = 0; ii < your_decks.size(); ++ii){
+			auto tdeck = your_decks[ii]->clone();
 			copy_deck(tdeck,cur_deck);
-			auto tscore = fitness(cur_deck,nil,evaluated_decks,zero_results,skipped_simulations,proc);
-			if(!contains(best,cur_deck))best.insert(std::make_pair(tscore,tdeck));
+			if(!contains(best,cur_deck))best.insert(std::make_pair(passed_scores[ii],tdeck));
 			if(best.size()==pool_size+1)best.erase(std::prev(best.end(),1));
 	}
-	//fill remaining
+	//fill remaining (the missing mutations at once, again for the ones already in the pool)
 	while(best.size()<pool_size){
-		unsigned j = std::uniform_int_distribution<unsigned>(0,your_decks.size()-1)(re);
-		unsigned i = std::uniform_int_distribution<unsigned>(0,your_decks.size()-1)(re);
-		Deck* nxt = your_decks[j]->clone();
-		mutate(your_decks[i],nxt,card_candidates,re,cur_gap,evaluated_decks); //no crossovers here only fill with mutations
-		copy_deck(nxt,cur_deck);
-		auto tscore = fitness(cur_deck,nil,evaluated_decks,zero_results,skipped_simulations,proc);
-		if(!contains(best,nxt)){best.insert(std::make_pair(tscore,nxt));}
+		std::vector<Deck*> fill_decks;
+		for(unsigned it = best.size(); it < pool_size; ++it){
+			unsigned j = std::uniform_int_distribution<unsigned>(0,your_decks.size()-1)(re);
+			unsigned i = std::uniform_int_distribution<unsigned>(0,your_decks.size()-1)(re);
+			Deck* nxt = your_decks[j]->clone();
+			mutate(your_decks[i],nxt,card_candidates,re,cur_gap,evaluated_decks); //no crossovers here only fill with mutations
+			fill_decks.push_back(nxt);
+		}
+		auto fill_scores = batch_fitness(fill_decks,cur_deck,nil,evaluated_decks,zero_results,skipped_simulations,proc,false);
+		for(unsigned it = 0; it < fill_decks.size(); ++it){
+			if(best.size()<pool_size && !contains(best,fill_decks[it])){best.insert(std::make_pair(fill_scores[it],fill_decks[it]));}
+			else{delete fill_decks[it];}
+		}
 	}
 
 	while(true)
@@ -1070,13 +1336,15 @@ FinalResults<long double> beam_climb(unsigned num_min_iterations, unsigned num_i
 		{
 			best_decks.push_back(it->second);
 		}
-		//sim deck
-		for( auto i_deck :best_decks)
+		//sim decks (at once: grab from stored results or sim them)
+		auto beam_scores = batch_fitness(best_decks,cur_deck,nil,evaluated_decks,zero_results,skipped_simulations,proc,false);
+		for( unsigned beam_index = 0; beam_index < best_decks.size(); ++beam_index)
 		{
+			auto i_deck = best_decks[beam_index];
 			copy_deck(i_deck->clone(),cur_deck);
 			best_deck = i_deck->clone();
 			//copy_deck(i_deck,best_deck);
-			best_score = fitness(cur_deck,nil,evaluated_decks,zero_results,skipped_simulations,proc); // grab from stored results or sim it
+			best_score = beam_scores[beam_index];
 			from_slot = std::max(freezed_cards, (count_slot) % std::min<unsigned>(max_deck_len, best_deck->cards.size() + 1));
 			//climb + save best ones to best
 
@@ -1124,19 +1392,37 @@ FinalResults<long double> beam_climb(unsigned num_min_iterations, unsigned num_i
 		// shuffle candidates
 		std::shuffle(card_candidates.begin(), card_candidates.end(), re);
 
+		// to_slot range of a card candidate and moves to skip (2 Omega -> 2 Omega, void -> void)
+		auto to_slot_begin = [&](const Card* card_candidate) -> unsigned {
+			return is_random ? from_slot : card_candidate ? freezed_cards : (best_deck->cards.size() - 1);
+		};
+		auto to_slot_end = [&](const Card* card_candidate) -> unsigned {
+			return is_random ? (from_slot + 1) : (best_deck->cards.size() + (from_slot < best_deck->cards.size() ? 0 : 1));
+		};
+		auto is_void_move = [&](const Card* card_candidate, unsigned to_slot) -> bool {
+			return card_candidate ?
+				(from_slot < best_deck->cards.size() && (from_slot == to_slot && card_candidate == best_deck->cards[to_slot])) // 2 Omega -> 2 Omega
+				:
+				(from_slot == best_deck->cards.size()); // void -> void
+		};
+
+		// << speculative card candidate loop >>
+		if (climb_speculative > 1)
+		{
+			try_improve_deck_candidates_speculative(cur_deck, from_slot, card_candidates,
+					to_slot_begin, to_slot_end, is_void_move, [&](){ check_and_update(best,cur_deck,deck_has_been_improved,best_score); },
+					best_deck->commander, best_deck->alpha_dominion, best_deck->cards, best_score, cur_gap, best_hash,
+					evaluated_decks, zero_results, skipped_simulations, proc, false);
+		}
+
 		// << card candidate loop >>
 		//for (const Card* card_candidate: card_candidates)
-		for (auto it = card_candidates.begin(); it != card_candidates.end();++it)
+		for (auto it = card_candidates.begin(); (climb_speculative <= 1) && (it != card_candidates.end());++it)
 		{
 			const Card* card_candidate = *it;
-			for (unsigned to_slot(is_random ? from_slot : card_candidate ? freezed_cards : (best_deck->cards.size() - 1));
-					to_slot < (is_random ? (from_slot + 1) : (best_deck->cards.size() + (from_slot < best_deck->cards.size() ? 0 : 1)));
-					++ to_slot)
+			for (unsigned to_slot(to_slot_begin(card_candidate)); to_slot < to_slot_end(card_candidate); ++ to_slot)
 			{
-				if (card_candidate ?
-						(from_slot < best_deck->cards.size() && (from_slot == to_slot && card_candidate == best_deck->cards[to_slot])) // 2 Omega -> 2 Omega
-						:
-						(from_slot == best_deck->cards.size())) // void -> void
+				if (is_void_move(card_candidate, to_slot))
 				{ continue; }
 
 				//std::cout << "TRY" << std::endl;
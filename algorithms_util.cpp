@@ -53,10 +53,10 @@ void append_unless_remove(C & self, C & oppo, typename C::const_reference val)
 
 // insert card at to_slot into deck limited by fund; store deck_cost
 // return true if affordable
-bool adjust_deck(Deck * deck, const signed from_slot, const signed to_slot, const Card * card, unsigned fund, std::mt19937 & re, unsigned & deck_cost,
+bool adjust_deck(Deck * deck, const signed from_slot, const signed to_slot, const Card * card, unsigned fund, RandomEngine & re, unsigned & deck_cost,
 		std::vector<std::pair<signed, const Card *>> & cards_out, std::vector<std::pair<signed, const Card *>> & cards_in)
 {
-	bool is_random = (deck->strategy == DeckStrategy::random) || (deck->strategy == DeckStrategy::flexible);
+	bool is_random = is_random_strategy(deck->strategy);
 	cards_out.clear();
 	cards_in.clear();
 	if (from_slot < 0)
@@ -0,0 +1,100 @@
+#ifndef BINOMIAL_BOUNDS_H_INCLUDED
+#define BINOMIAL_BOUNDS_H_INCLUDED
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <boost/math/distributions/binomial.hpp>
+#include <boost/math/distributions/normal.hpp>
+
+//------------------------------------------------------------------------------
+// One-sided bounds (each with probability alpha) on the success probability of
+// <successes> out of <trials> (successes may be fractional: a score scaled to [0, trials]).
+struct BinomialBounds
+{
+    double lower;
+    double upper;
+};
+
+// Clopper-Pearson (exact) bounds: boost's iterative inverse-beta solves, memoized per thread
+// since the same (trials, successes, alpha) come back for every rescoring of a deck
+inline BinomialBounds clopper_pearson_bounds(unsigned trials, double successes, double alpha)
+{
+    struct Key
+    {
+        unsigned trials;
+        double successes;
+        double alpha;
+        bool operator==(const Key& other) const
+        { return trials == other.trials && successes == other.successes && alpha == other.alpha; }
+    };
+    struct KeyHash
+    {
+        size_t operator()(const Key& key) const
+        {
+            uint64_t s, a;
+            std::memcpy(&s, &key.successes, sizeof(s));
+            std::memcpy(&a, &key.alpha, sizeof(a));
+            uint64_t h = key.trials;
+            h = (h ^ s) * 0x9E3779B97F4A7C15ull;
+            h = (h ^ a) * 0x9E3779B97F4A7C15ull;
+            return static_cast<size_t>(h ^ (h >> 29));
+        }
+    };
+    enum { max_cached_bounds = 1 << 16 };
+    thread_local std::unordered_map<Key, BinomialBounds, KeyHash> cache;
+    Key key{trials, successes, alpha};
+    auto it = cache.find(key);
+    if (it != cache.end())
+    { return it->second; }
+    if (cache.size() >= max_cached_bounds)
+    { cache.clear(); }
+    BinomialBounds bounds{
+        boost::math::binomial_distribution<>::find_lower_bound_on_p(trials, successes, alpha),
+        boost::math::binomial_distribution<>::find_upper_bound_on_p(trials, successes, alpha)};
+    cache.emplace(key, bounds);
+    return bounds;
+}
+
+// z such that P(Z > z) = alpha for a standard normal Z (cached per thread for the last alpha)
+inline double normal_upper_quantile(double alpha)
+{
+    thread_local double z_alpha(-1), z(0);
+    if (alpha != z_alpha)
+    {
+        z = boost::math::quantile(boost::math::complement(boost::math::normal_distribution<>(), alpha));
+        z_alpha = alpha;
+    }
+    return z;
+}
+
+// Wilson score bounds: closed form, within ~1/trials of Clopper-Pearson (a bit narrower)
+inline BinomialBounds wilson_bounds(unsigned trials, double successes, double alpha)
+{
+    if (trials == 0)
+    { return BinomialBounds{0, 1}; }
+    double z = normal_upper_quantile(alpha);
+    double n = trials;
+    double p = successes / n;
+    double z2n = z * z / n;
+    double center = (p + z2n / 2) / (1 + z2n);
+    double half_width = z / (1 + z2n) * std::sqrt(p * (1 - p) / n + z2n / (4 * n));
+    return BinomialBounds{std::max(0.0, center - half_width), std::min(1.0, center + half_width)};
+}
+
+// Clopper-Pearson upper bound < threshold, exactly: the early stop checks of a comparison come with new
+// successes every time (no memo), so boost's solve only runs when the Wilson upper bound cannot decide
+// (it exceeds the exact one by less than z^2/trials)
+inline bool clopper_pearson_upper_below(unsigned trials, double successes, double alpha, double threshold)
+{
+    if (trials > 0)
+    {
+        double z = normal_upper_quantile(alpha);
+        if (wilson_bounds(trials, successes, alpha).upper - z * z / trials >= threshold)
+        { return false; }
+    }
+    return boost::math::binomial_distribution<>::find_upper_bound_on_p(trials, successes, alpha) < threshold;
+}
+
+#endif
@@ -7,6 +7,14 @@
 #include <map>
 #include "tyrant.h"
 
+// Skill pre-classified at load time (see Card::compile_skills()).
+struct CompiledSkill
+{
+    SkillSpec ss;
+    bool has_x;  // X-based activation skill (can be sabotaged / zeroed)
+    bool harmful;  // harmful activation skill (On Death: subject to the revenge fix)
+};
+
 class Card
 {
 public:
@@ -28,6 +36,11 @@ public:
     std::vector<SkillSpec> m_skills_on_death;
     unsigned m_skill_value[Skill::num_skills];
     Skill::Trigger m_skill_trigger[Skill::num_skills];
+    // skill program: built by compile_skills() once all cards are loaded
+    std::vector<CompiledSkill> m_activation_skills;  // activation skills of m_skills (in order)
+    std::vector<CompiledSkill> m_on_play_skills;  // m_skills_on_play (in order)
+    std::vector<CompiledSkill> m_on_attacked_skills;  // m_skills_on_attacked (in order)
+    std::vector<CompiledSkill> m_on_death_skills;  // m_skills_on_death (in order)
     CardType::CardType m_type;
     CardCategory::CardCategory m_category;
     const Card* m_top_level_card; // [TU] corresponding full-level card
@@ -53,6 +66,10 @@ public:
 	      //APN
 	      m_skills_on_attacked(),
         m_skills_on_death(),
+        m_activation_skills(),
+        m_on_play_skills(),
+        m_on_attacked_skills(),
+        m_on_death_skills(),
         m_type(CardType::assault),
         m_category(CardCategory::normal),
         m_top_level_card(this),
@@ -65,6 +82,7 @@ public:
     }
 
     void add_skill(Skill::Trigger trigger, Skill::Skill id, unsigned x, Faction y, unsigned n, unsigned c, Skill::Skill s, Skill::Skill s2 = Skill::no_skill, bool all = false, unsigned card_id = 0);
+    void compile_skills();
     bool is_top_level_card() const { return (this == m_top_level_card); }
     bool is_low_level_card() const { return (m_base_id == m_id); }
     const Card* upgraded() const { return is_top_level_card() ? this : m_used_for_cards.begin()->first; }
@@ -1,5 +1,6 @@
 #include "cards.h"
 
+#include <algorithm>
 #include <boost/tokenizer.hpp>
 #include <sstream>
 #include <stdexcept>
@@ -10,19 +11,53 @@
 #include "tyrant.h"
 #include "card.h"
 
+// Character c of a simplified name, or 0 if it is dropped.
+static inline char simple_char(char c)
+{
+    return(strchr(";:,\"'! ", c) ? 0 : ::tolower(c));
+}
+
 std::string simplify_name(const std::string& card_name)
 {
     std::string simple_name;
     for(auto c : card_name)
     {
-        if(!strchr(";:,\"'! ", c))
+        if(char s = simple_char(c))
         {
-            simple_name += ::tolower(c);
+            simple_name += s;
         }
     }
     return(simple_name);
 }
 
+// FNV-1a of the simplified name
+static size_t simple_name_hash(const char* begin, const char* end)
+{
+    size_t hash(2166136261u);
+    for (; begin != end; ++begin)
+    {
+        if (char s = simple_char(*begin))
+        {
+            hash = (hash ^ static_cast<unsigned char>(s)) * 16777619u;
+        }
+    }
+    return(hash);
+}
+
+static bool simple_name_equals(const char* begin, const char* end, const std::string& simple_name)
+{
+    auto simple_iter = simple_name.begin();
+    for (; begin != end; ++begin)
+    {
+        if (char s = simple_char(*begin))
+        {
+            if (simple_iter == simple_name.end() || *simple_iter != s) { return(false); }
+            ++simple_iter;
+        }
+    }
+    return(simple_iter == simple_name.end());
+}
+
 std::list<std::string> get_abbreviations(const std::string& name)
 {
     std::list<std::string> abbr_list;
@@ -46,14 +81,77 @@ Cards::~Cards()
 
 const Card* Cards::by_id(unsigned id) const
 {
-    const auto cardIter = cards_by_id.find(id);
-    if (cardIter == cards_by_id.end())
+    if (id < cards_by_id_table.size())
     {
-        throw std::runtime_error("No card with id " + to_string(id));
+        if (cards_by_id_table[id]) { return(cards_by_id_table[id]); }
     }
     else
     {
-        return(cardIter->second);
+        // ids beyond the table (see index_ids())
+        const auto cardIter = cards_by_id.find(id);
+        if (cardIter != cards_by_id.end() && cardIter->second) { return(cardIter->second); }
+    }
+    throw std::runtime_error("No card with id " + to_string(id));
+}
+
+const Cards::NameSlot* Cards::find_name(const char* begin, const char* end) const
+{
+    if (name_slots.empty()) { return(nullptr); }
+    size_t hash = simple_name_hash(begin, end);
+    size_t mask = name_slots.size() - 1;
+    for (size_t i = hash & mask; name_slots[i].name; i = (i + 1) & mask)
+    {
+        if (name_slots[i].hash == hash && simple_name_equals(begin, end, *name_slots[i].name))
+        {
+            return(&name_slots[i]);
+        }
+    }
+    return(nullptr);
+}
+
+Cards::NameSlot& Cards::add_name_slot(const std::string& name)
+{
+    size_t hash = simple_name_hash(name.data(), name.data() + name.size());
+    size_t mask = name_slots.size() - 1;
+    size_t i = hash & mask;
+    for (; name_slots[i].name; i = (i + 1) & mask)
+    {
+        if (name_slots[i].hash == hash && *name_slots[i].name == name) { return(name_slots[i]); }
+    }
+    name_slots[i].name = &name;
+    name_slots[i].hash = hash;
+    return(name_slots[i]);
+}
+
+void Cards::index_ids()
+{
+    // bounded, in case of sparse huge ids
+    const unsigned max_table_size(1u << 22);
+    unsigned table_size(cards_by_id.empty() ? 0 : std::min(cards_by_id.rbegin()->first + 1, max_table_size));
+    cards_by_id_table.assign(table_size, nullptr);
+    for (const auto& card_by_id: cards_by_id)
+    {
+        if (card_by_id.first >= table_size) { break; }
+        cards_by_id_table[card_by_id.first] = card_by_id.second;
+    }
+}
+
+void Cards::index_names()
+{
+    // keys are simplified already; keep the load factor at most 1/2
+    size_t num_names(cards_by_name.size() + player_cards_abbr.size());
+    size_t table_size(16);
+    while (table_size < num_names * 2) { table_size <<= 1; }
+    name_slots.assign(table_size, NameSlot{});
+    for (const auto& card_by_name: cards_by_name)
+    {
+        NameSlot& slot = add_name_slot(card_by_name.first);
+        slot.card = card_by_name.second;
+        slot.ambiguous = ambiguous_names.count(card_by_name.first) > 0;
+    }
+    for (const auto& abbr: player_cards_abbr)
+    {
+        add_name_slot(abbr.first).abbr = &abbr.second;
     }
 }
 //------------------------------------------------------------------------------
@@ -70,6 +168,7 @@ void Cards::organize()
     {
         cards_by_id[card->m_id] = card;
     }
+    index_ids();
 
     // Round 2: depend on cards_by_id / by_id(); update m_name, [TU] m_top_level_card etc.; set cards_by_name; 
     for (Card* card: all_cards)
@@ -108,11 +207,16 @@ void Cards::organize()
             card->m_skill_value[Skill::summon] = 0;
         }
     }
+    // Round 4: precompile skill programs (skills are final from now on)
+    for (Card* card: all_cards)
+    {
+        card->compile_skills();
+    }
     //Test
-    //Round 4: sort cards by id
+    //Round 5: sort cards by id
     struct { bool operator()(Card* a, Card* b) const {return a->m_id < b->m_id;}} idsort;
     std::sort(all_cards.begin(),all_cards.end(),idsort);
-
+    index_names();
 
 }
 //------------------------------------------------------------------------------
@@ -223,3 +327,21 @@ void Card::add_skill(Skill::Trigger trigger, Skill::Skill id, unsigned x, Factio
     m_skill_value[id] = x ? x : n ? n : card_id ? card_id : 1;
     m_skill_trigger[id] = trigger;
 }
+
+// Pre-classify skills once so that the simulator does not re-check triggers and skill kinds on every action
+void Card::compile_skills()
+{
+    auto compile = [](const std::vector<SkillSpec>& skills, std::vector<CompiledSkill>& compiled, bool activation_only)
+    {
+        compiled.clear();
+        for (const SkillSpec& ss: skills)
+        {
+            if (activation_only && !is_activation_skill(ss.id)) { continue; }
+            compiled.push_back({ss, is_activation_skill_with_x(ss.id), is_activation_harmful_skill(ss.id)});
+        }
+    };
+    compile(m_skills, m_activation_skills, true);
+    compile(m_skills_on_play, m_on_play_skills, false);
+    compile(m_skills_on_attacked, m_on_attacked_skills, false);
+    compile(m_skills_on_death, m_on_death_skills, false);
+}
@@ -11,6 +11,16 @@ class Card;
 class Cards
 {
 public:
+    // Slot of the name hash table: a simplified name of cards_by_name and/or player_cards_abbr.
+    struct NameSlot
+    {
+        const std::string* name = nullptr; // key of cards_by_name / player_cards_abbr; nullptr: empty slot
+        size_t hash = 0;
+        Card* card = nullptr;
+        const std::string* abbr = nullptr; // abbreviated card spec
+        bool ambiguous = false;
+    };
+
     ~Cards();
 
     std::vector<Card*> all_cards;
@@ -24,10 +34,20 @@ public:
     std::unordered_set<unsigned> visible_cardset;
     std::unordered_set<std::string> ambiguous_names;
     const Card* by_id(unsigned id) const;
+    // Looks up the name [begin, end) simplified on the fly (see simplify_name()), without allocating.
+    const NameSlot* find_name(const char* begin, const char* end) const;
+    // Rebuild the lookup tables of by_id() / find_name() after cards_by_id / cards_by_name, player_cards_abbr change.
+    void index_ids();
+    void index_names();
     void organize();
     void fix_dominion_recipes();
     void add_card(Card* card, const std::string & name);
     void erase_fusion_recipe(unsigned card_id);
+
+private:
+    std::vector<Card*> cards_by_id_table; // cards_by_id indexed by id
+    std::vector<NameSlot> name_slots; // open addressing, power of two size
+    NameSlot& add_name_slot(const std::string& name);
 };
 
 std::string simplify_name(const std::string& card_name);
@@ -0,0 +1,423 @@
+#include "cards_cache.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <stdexcept>
+#include <unordered_map>
+#include <boost/filesystem.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "card.h"
+#include "cards.h"
+#include "tyrant.h"
+
+#ifndef TYRANT_OPTIMIZER_VERSION
+#define TYRANT_OPTIMIZER_VERSION "--"
+#endif
+
+// Layout (native byte order, checked): header (magic, format, sizes, program version, source stamps),
+// visible card sets, the cards (in address order, so that the maps keyed by Card* keep their order),
+// then Cards' containers and the dominion costs/refunds, with the cards as indices.
+// Bump cards_cache_format whenever the layout or Card changes.
+static const char cards_cache_magic[8] = {'T', 'U', 'O', 'C', 'A', 'R', 'D', 'S'};
+static const uint32_t cards_cache_format = 1;
+static const uint32_t cards_cache_byte_order = 0x01020304;
+static const uint32_t cards_cache_end = 0x454e4421;
+
+struct CacheWriter
+{
+    std::ofstream out;
+    void u32(uint32_t value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); }
+    void u64(uint64_t value) { out.write(reinterpret_cast<const char*>(&value), sizeof(value)); }
+    void str(const std::string& value)
+    {
+        u32(value.size());
+        out.write(value.data(), value.size());
+    }
+};
+
+struct CacheReader
+{
+    const char* pos;
+    const char* end;
+    void need(size_t size)
+    {
+        if (static_cast<size_t>(end - pos) < size) { throw std::runtime_error("truncated"); }
+    }
+    uint32_t u32()
+    {
+        uint32_t value;
+        need(sizeof(value));
+        std::memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return value;
+    }
+    uint64_t u64()
+    {
+        uint64_t value;
+        need(sizeof(value));
+        std::memcpy(&value, pos, sizeof(value));
+        pos += sizeof(value);
+        return value;
+    }
+    std::string str()
+    {
+        uint32_t size(u32());
+        need(size);
+        std::string value(pos, size);
+        pos += size;
+        return value;
+    }
+};
+
+// size and mtime of every source file (size ~0: missing)
+static void write_stamps(CacheWriter& writer, const std::vector<std::string>& source_filenames)
+{
+    writer.u32(source_filenames.size());
+    for (const auto& filename: source_filenames)
+    {
+        boost::system::error_code ec;
+        uint64_t size = boost::filesystem::file_size(filename, ec);
+        std::time_t mtime = ec ? 0 : boost::filesystem::last_write_time(filename, ec);
+        writer.str(filename);
+        writer.u64(ec ? ~uint64_t(0) : size);
+        writer.u64(static_cast<uint64_t>(mtime));
+    }
+}
+
+static bool stamps_match(CacheReader& reader, const std::vector<std::string>& source_filenames)
+{
+    if (reader.u32() != source_filenames.size()) { return false; }
+    for (const auto& filename: source_filenames)
+    {
+        boost::system::error_code ec;
+        uint64_t size = boost::filesystem::file_size(filename, ec);
+        std::time_t mtime = ec ? 0 : boost::filesystem::last_write_time(filename, ec);
+        if (reader.str() != filename) { return false; }
+        if (reader.u64() != (ec ? ~uint64_t(0) : size)) { return false; }
+        if (reader.u64() != static_cast<uint64_t>(mtime)) { return false; }
+    }
+    return true;
+}
+
+static void write_skills(CacheWriter& writer, const std::vector<SkillSpec>& skills)
+{
+    writer.u32(skills.size());
+    for (const SkillSpec& ss: skills)
+    {
+        writer.u32(ss.id);
+        writer.u32(ss.x);
+        writer.u32(ss.y);
+        writer.u32(ss.n);
+        writer.u32(ss.c);
+        writer.u32(ss.s);
+        writer.u32(ss.s2);
+        writer.u32(ss.all);
+        writer.u32(ss.card_id);
+    }
+}
+
+static void read_skills(CacheReader& reader, std::vector<SkillSpec>& skills)
+{
+    skills.resize(reader.u32());
+    for (SkillSpec& ss: skills)
+    {
+        ss.id = static_cast<Skill::Skill>(reader.u32());
+        ss.x = reader.u32();
+        ss.y = static_cast<Faction>(reader.u32());
+        ss.n = reader.u32();
+        ss.c = reader.u32();
+        ss.s = static_cast<Skill::Skill>(reader.u32());
+        ss.s2 = static_cast<Skill::Skill>(reader.u32());
+        ss.all = reader.u32();
+        ss.card_id = reader.u32();
+    }
+}
+
+//------------------------------------------------------------------------------
+bool save_cards_cache(const Cards& all_cards, const std::string& cache_filename, const std::vector<std::string>& source_filenames)
+{
+    // cards in address order, and their indices
+    std::vector<const Card*> cards(all_cards.all_cards.begin(), all_cards.all_cards.end());
+    std::sort(cards.begin(), cards.end(), std::less<const Card*>());
+    std::unordered_map<const Card*, uint32_t> index;
+    for (uint32_t i(0); i < cards.size(); ++i) { index[cards[i]] = i; }
+    auto card_index = [&index](const Card* card) -> uint32_t {
+        auto it = index.find(card);
+        if (it == index.end()) { throw std::runtime_error("card outside of all_cards"); }
+        return it->second;
+    };
+    auto write_card_counts = [&card_index](CacheWriter& writer, const std::map<const Card*, unsigned>& counts) {
+        writer.u32(counts.size());
+        for (const auto& count: counts)
+        {
+            writer.u32(card_index(count.first));
+            writer.u32(count.second);
+        }
+    };
+
+    // unique per writer: runs sharing the data directory may save the cache at the same time
+    const std::string tmp_filename(cache_filename + boost::filesystem::unique_path(".%%%%-%%%%-%%%%.tmp").string());
+    try
+    {
+        CacheWriter writer;
+        writer.out.open(tmp_filename, std::ios::binary | std::ios::trunc);
+        if (!writer.out) { return false; }
+        writer.out.write(cards_cache_magic, sizeof(cards_cache_magic));
+        writer.u32(cards_cache_format);
+        writer.u32(cards_cache_byte_order);
+        writer.u32(sizeof(Card));
+        writer.u32(Skill::num_skills);
+        writer.str(TYRANT_OPTIMIZER_VERSION);
+        write_stamps(writer, source_filenames);
+
+        writer.u32(all_cards.visible_cardset.size());
+        for (unsigned set: all_cards.visible_cardset) { writer.u32(set); }
+
+        writer.u32(cards.size());
+        for (const Card* card: cards)
+        {
+            writer.u32(card->m_attack);
+            writer.u32(card->m_base_id);
+            writer.u32(card->m_delay);
+            writer.u32(card->m_faction);
+            writer.u32(card->m_health);
+            writer.u32(card->m_id);
+            writer.u32(card->m_level);
+            writer.u32(card->m_fusion_level);
+            writer.str(card->m_name);
+            writer.u32(card->m_rarity);
+            writer.u32(card->m_set);
+            write_skills(writer, card->m_skills);
+            write_skills(writer, card->m_skills_on_play);
+            write_skills(writer, card->m_skills_on_attacked);
+            write_skills(writer, card->m_skills_on_death);
+            for (unsigned id(0); id < Skill::num_skills; ++id)
+            {
+                writer.u32(card->m_skill_value[id]);
+                writer.u32(card->m_skill_trigger[id]);
+            }
+            writer.u32(card->m_type);
+            writer.u32(card->m_category);
+            writer.u32(card_index(card->m_top_level_card));
+            writer.u32(card->m_recipe_cost);
+            write_card_counts(writer, card->m_recipe_cards);
+            write_card_counts(writer, card->m_used_for_cards);
+        }
+
+        writer.u32(all_cards.all_cards.size());
+        for (const Card* card: all_cards.all_cards) { writer.u32(card_index(card)); }
+        writer.u32(all_cards.cards_by_id.size());
+        for (const auto& card_by_id: all_cards.cards_by_id)
+        {
+            writer.u32(card_by_id.first);
+            writer.u32(card_by_id.second ? card_index(card_by_id.second) : ~uint32_t(0));
+        }
+        writer.u32(all_cards.cards_by_name.size());
+        for (const auto& card_by_name: all_cards.cards_by_name)
+        {
+            writer.str(card_by_name.first);
+            writer.u32(card_index(card_by_name.second));
+        }
+        for (const auto* card_list: {&all_cards.player_commanders, &all_cards.player_assaults, &all_cards.player_structures})
+        {
+            writer.u32(card_list->size());
+            for (const Card* card: *card_list) { writer.u32(card_index(card)); }
+        }
+        writer.u32(all_cards.player_cards.size());
+        for (const Card* card: all_cards.player_cards) { writer.u32(card_index(card)); }
+        writer.u32(all_cards.ambiguous_names.size());
+        for (const auto& name: all_cards.ambiguous_names) { writer.str(name); }
+        for (const auto* dominion: {&dominion_cost, &dominion_refund})
+        {
+            for (const auto& fusion_level: *dominion)
+            {
+                for (const auto& counts: fusion_level) { write_card_counts(writer, counts); }
+            }
+        }
+        writer.u32(cards_cache_end);
+        writer.out.close();
+        if (!writer.out) { throw std::runtime_error("write error"); }
+        boost::filesystem::rename(tmp_filename, cache_filename);
+        return true;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "WARNING: cannot save the cards cache " << cache_filename << ": " << e.what() << std::endl;
+        boost::system::error_code ec;
+        boost::filesystem::remove(tmp_filename, ec);
+        return false;
+    }
+}
+
+//------------------------------------------------------------------------------
+static void clear_cards(Cards& all_cards)
+{
+    for (Card* card: all_cards.all_cards) { delete(card); }
+    all_cards.all_cards.clear();
+    all_cards.cards_by_id.clear();
+    all_cards.player_cards.clear();
+    all_cards.cards_by_name.clear();
+    all_cards.player_commanders.clear();
+    all_cards.player_assaults.clear();
+    all_cards.player_structures.clear();
+    all_cards.visible_cardset.clear();
+    all_cards.ambiguous_names.clear();
+    all_cards.index_ids();
+    all_cards.index_names();
+    for (auto* dominion: {&dominion_cost, &dominion_refund})
+    {
+        for (auto& fusion_level: *dominion)
+        {
+            for (auto& counts: fusion_level) { counts.clear(); }
+        }
+    }
+}
+
+bool load_cards_cache(Cards& all_cards, const std::string& cache_filename, const std::vector<std::string>& source_filenames)
+{
+    namespace bip = boost::interprocess;
+    boost::system::error_code ec;
+    if (!boost::filesystem::exists(cache_filename, ec) || (boost::filesystem::file_size(cache_filename, ec) == 0))
+    { return false; }
+    std::vector<Card*> cards;
+    try
+    {
+        bip::file_mapping mapping(cache_filename.c_str(), bip::read_only);
+        bip::mapped_region region(mapping, bip::read_only);
+        CacheReader reader{static_cast<const char*>(region.get_address()), static_cast<const char*>(region.get_address()) + region.get_size()};
+        reader.need(sizeof(cards_cache_magic));
+        if (std::memcmp(reader.pos, cards_cache_magic, sizeof(cards_cache_magic)) != 0)
+        {
+            std::cerr << "WARNING: " << cache_filename << " is not a cards cache, loading the XML" << std::endl;
+            return false;
+        }
+        reader.pos += sizeof(cards_cache_magic);
+        if (reader.u32() != cards_cache_format || reader.u32() != cards_cache_byte_order
+                || reader.u32() != sizeof(Card) || reader.u32() != Skill::num_skills
+                || reader.str() != TYRANT_OPTIMIZER_VERSION)
+        {
+            std::cerr << "WARNING: the cards cache " << cache_filename << " is of another version, loading the XML" << std::endl;
+            return false;
+        }
+        if (!stamps_match(reader, source_filenames))
+        {
+            std::cerr << "WARNING: the cards cache " << cache_filename << " does not match the XML files (changed since it was saved), loading the XML" << std::endl;
+            return false;
+        }
+
+        for (uint32_t i(reader.u32()); i > 0; --i) { all_cards.visible_cardset.insert(reader.u32()); }
+
+        // the cards first (allocated in the saved order), links to other cards once they all exist
+        struct CardLinks
+        {
+            uint32_t top_level_card;
+            std::vector<std::pair<uint32_t, unsigned>> recipe_cards, used_for_cards;
+        };
+        auto read_card_counts = [&reader]() {
+            std::vector<std::pair<uint32_t, unsigned>> counts(reader.u32());
+            for (auto& count: counts)
+            {
+                count.first = reader.u32();
+                count.second = reader.u32();
+            }
+            return counts;
+        };
+        std::vector<CardLinks> links(reader.u32());
+        reader.need(links.size() * sizeof(uint32_t));
+        // allocated up front and handed out by address, so that the maps keyed by Card* get the saved order
+        for (uint32_t i(0); i < links.size(); ++i) { cards.push_back(new Card()); }
+        std::sort(cards.begin(), cards.end(), std::less<Card*>());
+        auto card_it = cards.begin();
+        for (CardLinks& card_links: links)
+        {
+            Card* card = *(card_it++);
+            card->m_attack = reader.u32();
+            card->m_base_id = reader.u32();
+            card->m_delay = reader.u32();
+            card->m_faction = static_cast<Faction>(reader.u32());
+            card->m_health = reader.u32();
+            card->m_id = reader.u32();
+            card->m_level = reader.u32();
+            card->m_fusion_level = reader.u32();
+            card->m_name = reader.str();
+            card->m_rarity = reader.u32();
+            card->m_set = reader.u32();
+            read_skills(reader, card->m_skills);
+            read_skills(reader, card->m_skills_on_play);
+            read_skills(reader, card->m_skills_on_attacked);
+            read_skills(reader, card->m_skills_on_death);
+            for (unsigned id(0); id < Skill::num_skills; ++id)
+            {
+                card->m_skill_value[id] = reader.u32();
+                card->m_skill_trigger[id] = static_cast<Skill::Trigger>(reader.u32());
+            }
+            card->m_type = static_cast<CardType::CardType>(reader.u32());
+            card->m_category = static_cast<CardCategory::CardCategory>(reader.u32());
+            card_links.top_level_card = reader.u32();
+            card->m_recipe_cost = reader.u32();
+            card_links.recipe_cards = read_card_counts();
+            card_links.used_for_cards = read_card_counts();
+        }
+        auto card_at = [&cards](uint32_t index) -> Card* {
+            if (index >= cards.size()) { throw std::runtime_error("bad card index"); }
+            return cards[index];
+        };
+        for (uint32_t i(0); i < cards.size(); ++i)
+        {
+            cards[i]->m_top_level_card = card_at(links[i].top_level_card);
+            for (const auto& count: links[i].recipe_cards) { cards[i]->m_recipe_cards[card_at(count.first)] = count.second; }
+            for (const auto& count: links[i].used_for_cards) { cards[i]->m_used_for_cards[card_at(count.first)] = count.second; }
+            cards[i]->compile_skills();
+        }
+
+        std::vector<Card*> sorted_cards(reader.u32());
+        if (sorted_cards.size() != cards.size()) { throw std::runtime_error("bad card count"); }
+        for (Card*& card: sorted_cards) { card = card_at(reader.u32()); }
+        for (uint32_t i(reader.u32()); i > 0; --i)
+        {
+            unsigned id = reader.u32();
+            uint32_t index = reader.u32();
+            all_cards.cards_by_id[id] = (index == ~uint32_t(0)) ? nullptr : card_at(index);
+        }
+        for (uint32_t i(reader.u32()); i > 0; --i)
+        {
+            std::string name(reader.str());
+            all_cards.cards_by_name[name] = card_at(reader.u32());
+        }
+        for (auto* card_list: {&all_cards.player_commanders, &all_cards.player_assaults, &all_cards.player_structures})
+        {
+            for (uint32_t i(reader.u32()); i > 0; --i) { card_list->push_back(card_at(reader.u32())); }
+        }
+        for (uint32_t i(reader.u32()); i > 0; --i) { all_cards.player_cards.insert(card_at(reader.u32())); }
+        for (uint32_t i(reader.u32()); i > 0; --i) { all_cards.ambiguous_names.insert(reader.str()); }
+        for (auto* dominion: {&dominion_cost, &dominion_refund})
+        {
+            for (auto& fusion_level: *dominion)
+            {
+                for (auto& counts: fusion_level)
+                {
+                    counts.clear();
+                    for (const auto& count: read_card_counts()) { counts[card_at(count.first)] = count.second; }
+                }
+            }
+        }
+        if (reader.u32() != cards_cache_end) { throw std::runtime_error("bad end marker"); }
+        all_cards.all_cards = sorted_cards; // owns the cards from now on
+        all_cards.index_ids();
+        all_cards.index_names();
+        return true;
+    }
+    catch (std::exception& e)
+    {
+        std::cerr << "WARNING: cannot load the cards cache " << cache_filename << " (" << e.what() << "), loading the XML" << std::endl;
+        for (Card* card: cards) { delete(card); }
+        clear_cards(all_cards);
+        return false;
+    }
+}
@@ -0,0 +1,17 @@
+#ifndef CARDS_CACHE_H_INCLUDED
+#define CARDS_CACHE_H_INCLUDED
+
+#include <string>
+#include <vector>
+
+class Cards;
+
+// Binary snapshot of the organized cards (skills_set.xml, cards_section_*.xml and levels.xml loaded,
+// Cards::organize() and Cards::fix_dominion_recipes() done), with the dominion costs and refunds.
+// It is stamped with the version of the program and the size and mtime of every source file:
+// load_cards_cache() returns false (and leaves all_cards empty) if it is missing, of another
+// version or stale, so that the cards are loaded from the XML instead (and saved again).
+bool load_cards_cache(Cards& all_cards, const std::string& cache_filename, const std::vector<std::string>& source_filenames);
+bool save_cards_cache(const Cards& all_cards, const std::string& cache_filename, const std::vector<std::string>& source_filenames);
+
+#endif
@@ -0,0 +1,427 @@
+#include "daemon.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <boost/tokenizer.hpp>
+#include "tyrant_optimize.h"
+
+#if defined(_WIN32)
+
+bool serve_daemon_requests(TuoData&, int, int)
+{
+    std::cerr << "Error: daemon mode is not supported on this platform" << std::endl;
+    return true;
+}
+
+int run_daemon(int, char**)
+{
+    std::cerr << "Error: daemon mode is not supported on this platform" << std::endl;
+    return 1;
+}
+
+#else
+
+#include <cerrno>
+#include <csignal>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+static std::string json_string(const std::string& value)
+{
+    std::ostringstream json;
+    json << '"';
+    for (unsigned char c: value)
+    {
+        switch (c)
+        {
+        case '"': json << "\\\""; break;
+        case '\\': json << "\\\\"; break;
+        case '\n': json << "\\n"; break;
+        case '\r': json << "\\r"; break;
+        case '\t': json << "\\t"; break;
+        default:
+            if (c < 0x20) { json << "\\u" << std::hex << std::setw(4) << std::setfill('0') << unsigned(c) << std::dec; }
+            else { json << c; }
+        }
+    }
+    json << '"';
+    return json.str();
+}
+
+// JSON has no nan or inf (e.g. the points of enemy decks whose factors are all 0); they are told from
+// their exponent bits, as -Ofast (-ffinite-math-only) folds std::isfinite() to true
+static std::string json_number(long double value)
+{
+    double as_double(value);
+    uint64_t bits;
+    std::memcpy(&bits, &as_double, sizeof(bits));
+    if (((bits >> 52) & 0x7ff) == 0x7ff) { return "null"; }
+    std::ostringstream json;
+    json << std::setprecision(10) << value;
+    return json.str();
+}
+
+// one session: the requests read from in_fd, the JSON lines written to out_fd (false once it is closed)
+struct DaemonSession
+{
+    int in_fd;
+    int out_fd;
+    bool out_ok;
+    std::vector<int> fds_to_close; // in the children
+
+    bool write_line(const std::string& line)
+    {
+        std::string buffer(line + "\n");
+        const char* pos = buffer.data();
+        size_t left = buffer.size();
+        while (out_ok && (left > 0))
+        {
+            ssize_t written = ::write(out_fd, pos, left);
+            if (written < 0)
+            {
+                if (errno == EINTR) { continue; }
+                out_ok = false;
+                break;
+            }
+            pos += written;
+            left -= written;
+        }
+        return out_ok;
+    }
+};
+
+static std::vector<std::string> split_request(const std::string& line)
+{
+    std::vector<std::string> args;
+    try
+    {
+        boost::tokenizer<boost::escaped_list_separator<char>> tokens(line, boost::escaped_list_separator<char>(std::string("\\"), std::string(" \t"), std::string("\"")));
+        for (const auto& token: tokens)
+        {
+            if (!token.empty()) { args.push_back(token); }
+        }
+    }
+    catch (const boost::escaped_list_error& e)
+    {
+        throw std::runtime_error(std::string("bad request: ") + e.what());
+    }
+    return args;
+}
+
+// the flags of a request default to the daemon's prefix and suffixes (after the decks, so that the
+// prefix applies to the -o= flags), or run() would load the data again
+static void add_data_flags(const TuoData& data, std::vector<std::string>& args)
+{
+    bool has_prefix(false), has_suffix(false);
+    for (size_t index(2); index < args.size(); ++index)
+    {
+        has_prefix |= (args[index] == "prefix");
+        has_suffix |= (args[index][0] == '_');
+    }
+    if (!has_suffix)
+    {
+        args.insert(args.end(), data.fn_suffix_list.begin() + 1, data.fn_suffix_list.end());
+    }
+    if (!has_prefix && !data.prefix.empty())
+    {
+        args.insert(args.begin() + 2, {"prefix", data.prefix});
+    }
+}
+
+// the child: run() on the loaded data, its output in the pipes, its result in result_fd;
+// it leaves with _exit(), not to run the daemon's atexit handlers and static destructors
+static void run_request(TuoData& data, std::vector<std::string> args, int out_fd, int err_fd, int result_fd)
+{
+    dup2(out_fd, STDOUT_FILENO);
+    dup2(err_fd, STDERR_FILENO);
+    close(out_fd);
+    close(err_fd);
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+    add_data_flags(data, args);
+    args.insert(args.begin(), "tuo");
+    std::vector<char*> argv;
+    for (auto& arg: args) { argv.push_back(&arg[0]); }
+    argv.push_back(nullptr);
+    init();
+    start_time = std::chrono::system_clock::now();
+    FinalResults<long double> fr;
+    try
+    {
+        fr = run(args.size(), argv.data(), &data);
+    }
+    catch (const std::exception& e)
+    {
+        std::cerr << "Error: " << e.what() << std::endl;
+        std::cout << std::flush;
+        std::fflush(stdout);
+        _exit(1);
+    }
+    std::cout << std::flush;
+    std::fflush(stdout);
+    ssize_t written = ::write(result_fd, &fr, sizeof(fr));
+    _exit(written == sizeof(fr) ? 0 : 1);
+}
+
+static void relay_output(DaemonSession& session, unsigned id, int out_fd, int err_fd)
+{
+    struct pollfd fds[2] = {{out_fd, POLLIN, 0}, {err_fd, POLLIN, 0}};
+    const char* stream_names[2] = {"stdout", "stderr"};
+    std::string pending[2];
+    auto write_output = [&session, id, &stream_names](unsigned stream, const std::string& line) {
+        session.write_line("{\"id\":" + std::to_string(id) + ",\"stream\":\"" + stream_names[stream] + "\",\"line\":" + json_string(line) + "}");
+    };
+    unsigned num_open = 2;
+    while (num_open > 0)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR) { continue; }
+            break;
+        }
+        for (unsigned stream(0); stream < 2; ++stream)
+        {
+            if ((fds[stream].fd < 0) || !fds[stream].revents) { continue; }
+            char buffer[4096];
+            ssize_t size = ::read(fds[stream].fd, buffer, sizeof(buffer));
+            if ((size < 0) && (errno == EINTR)) { continue; }
+            if (size <= 0)
+            {
+                fds[stream].fd = -1;
+                -- num_open;
+                continue;
+            }
+            pending[stream].append(buffer, size);
+            size_t eol;
+            while ((eol = pending[stream].find('\n')) != std::string::npos)
+            {
+                write_output(stream, pending[stream].substr(0, eol));
+                pending[stream].erase(0, eol + 1);
+            }
+        }
+    }
+    for (unsigned stream(0); stream < 2; ++stream)
+    {
+        if (!pending[stream].empty()) { write_output(stream, pending[stream]); }
+    }
+}
+
+static void serve_request(DaemonSession& session, TuoData& data, unsigned id, const std::vector<std::string>& args)
+{
+    int out_pipe[2], err_pipe[2], result_pipe[2];
+    if (pipe(out_pipe) != 0 || pipe(err_pipe) != 0 || pipe(result_pipe) != 0)
+    {
+        session.write_line("{\"id\":" + std::to_string(id) + ",\"done\":true,\"error\":" + json_string(std::string("pipe: ") + std::strerror(errno)) + "}");
+        return;
+    }
+    std::cout << std::flush;
+    std::fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(out_pipe[0]);
+        close(err_pipe[0]);
+        close(result_pipe[0]);
+        for (int fd: session.fds_to_close) { close(fd); }
+        run_request(data, args, out_pipe[1], err_pipe[1], result_pipe[1]);
+    }
+    close(out_pipe[1]);
+    close(err_pipe[1]);
+    close(result_pipe[1]);
+    if (pid < 0)
+    {
+        session.write_line("{\"id\":" + std::to_string(id) + ",\"done\":true,\"error\":" + json_string(std::string("fork: ") + std::strerror(errno)) + "}");
+        close(out_pipe[0]);
+        close(err_pipe[0]);
+        close(result_pipe[0]);
+        return;
+    }
+    relay_output(session, id, out_pipe[0], err_pipe[0]);
+    close(out_pipe[0]);
+    close(err_pipe[0]);
+
+    FinalResults<long double> fr;
+    size_t result_size(0);
+    while (result_size < sizeof(fr))
+    {
+        ssize_t size = ::read(result_pipe[0], reinterpret_cast<char*>(&fr) + result_size, sizeof(fr) - result_size);
+        if ((size < 0) && (errno == EINTR)) { continue; }
+        if (size <= 0) { break; }
+        result_size += size;
+    }
+    close(result_pipe[0]);
+    int status(0);
+    while ((waitpid(pid, &status, 0) < 0) && (errno == EINTR));
+
+    std::ostringstream done;
+    done << "{\"id\":" << id << ",\"done\":true,\"exit_status\":"
+        << (WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status));
+    if (result_size == sizeof(fr))
+    {
+        done << ",\"result\":{\"points\":" << json_number(fr.points)
+            << ",\"points_lower_bound\":" << json_number(fr.points_lower_bound)
+            << ",\"points_upper_bound\":" << json_number(fr.points_upper_bound)
+            << ",\"wins\":" << json_number(fr.wins) << ",\"draws\":" << json_number(fr.draws) << ",\"losses\":" << json_number(fr.losses)
+            << ",\"n_sims\":" << fr.n_sims << "}";
+    }
+    done << "}";
+    session.write_line(done.str());
+}
+
+// false on "quit"
+static bool serve_session(DaemonSession& session, TuoData& data)
+{
+    session.write_line("{\"ready\":true,\"cards\":" + std::to_string(data.all_cards.all_cards.size())
+        + ",\"deck_names\":" + std::to_string(data.decks.num_deck_names()) + "}");
+    unsigned num_requests(0);
+    std::string input;
+    bool eof(false);
+    while (session.out_ok)
+    {
+        size_t eol = input.find('\n');
+        if (eol == std::string::npos)
+        {
+            if (eof) { break; }
+            char buffer[4096];
+            ssize_t size = ::read(session.in_fd, buffer, sizeof(buffer));
+            if ((size < 0) && (errno == EINTR)) { continue; }
+            if (size <= 0)
+            {
+                eof = true;
+                if (!input.empty()) { input += '\n'; }
+                continue;
+            }
+            input.append(buffer, size);
+            continue;
+        }
+        std::string line(input.substr(0, eol));
+        input.erase(0, eol + 1);
+        if (!line.empty() && (line.back() == '\r')) { line.pop_back(); }
+        std::vector<std::string> args;
+        try
+        {
+            args = split_request(line);
+        }
+        catch (const std::runtime_error& e)
+        {
+            session.write_line("{\"id\":" + std::to_string(++ num_requests) + ",\"done\":true,\"error\":" + json_string(e.what()) + "}");
+            continue;
+        }
+        if (args.empty() || (args[0][0] == '#')) { continue; }
+        if ((args.size() == 1) && (args[0] == "quit")) { return false; }
+        ++ num_requests;
+        if (args.size() < 2)
+        {
+            session.write_line("{\"id\":" + std::to_string(num_requests) + ",\"done\":true,\"error\":\"expected: Your_Deck Enemy_Deck [Flags] [Operations]\"}");
+            continue;
+        }
+        serve_request(session, data, num_requests, args);
+    }
+    return true;
+}
+
+static int serve_socket(TuoData& data, const std::string& socket_path)
+{
+    struct sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path.size() >= sizeof(addr.sun_path))
+    {
+        std::cerr << "Error: daemon: socket path too long: " << socket_path << std::endl;
+        return 1;
+    }
+    std::strcpy(addr.sun_path, socket_path.c_str());
+    struct stat socket_stat;
+    if ((lstat(socket_path.c_str(), &socket_stat) == 0) && S_ISSOCK(socket_stat.st_mode))
+    {
+        unlink(socket_path.c_str()); // left by a previous daemon
+    }
+    int listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if ((listen_fd < 0)
+            || (bind(listen_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) != 0)
+            || (listen(listen_fd, 16) != 0))
+    {
+        std::cerr << "Error: daemon: cannot listen on " << socket_path << ": " << std::strerror(errno) << std::endl;
+        if (listen_fd >= 0) { close(listen_fd); }
+        return 1;
+    }
+    std::cerr << "daemon: listening on " << socket_path << std::endl;
+    bool quit(false);
+    while (!quit)
+    {
+        int client_fd = accept(listen_fd, nullptr, nullptr);
+        if (client_fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED) { continue; }
+            std::cerr << "Error: daemon: accept: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        DaemonSession session{client_fd, client_fd, true, {listen_fd, client_fd}};
+        quit = !serve_session(session, data);
+        close(client_fd);
+    }
+    close(listen_fd);
+    unlink(socket_path.c_str());
+    return 0;
+}
+
+bool serve_daemon_requests(TuoData& data, int in_fd, int out_fd)
+{
+    DaemonSession session{in_fd, out_fd, true, {}};
+    return serve_session(session, data);
+}
+
+int run_daemon(int argc, char** argv)
+{
+    TuoData data;
+    std::string socket_path;
+    init();
+    for (int argIndex = 2; argIndex < argc; ++argIndex)
+    {
+        if ((strcmp(argv[argIndex], "socket") == 0) && (argIndex + 1 < argc))
+        {
+            socket_path = argv[argIndex + 1];
+            argIndex += 1;
+        }
+        else if ((strcmp(argv[argIndex], "prefix") == 0) && (argIndex + 1 < argc))
+        {
+            data.prefix = argv[argIndex + 1];
+            argIndex += 1;
+        }
+        else if (strncmp(argv[argIndex], "_", 1) == 0)
+        {
+            data.fn_suffix_list.push_back(argv[argIndex]);
+        }
+        else if (strcmp(argv[argIndex], "no-cards-cache") == 0)
+        {
+            use_cards_cache = false;
+        }
+        else
+        {
+            std::cerr << "Error: Unknown daemon option " << argv[argIndex] << std::endl;
+            return 1;
+        }
+    }
+    std::signal(SIGPIPE, SIG_IGN); // a client gone: its writes fail instead
+    load_data(data);
+    if (!socket_path.empty())
+    {
+        return serve_socket(data, socket_path);
+    }
+    serve_daemon_requests(data, STDIN_FILENO, STDOUT_FILENO);
+    return 0;
+}
+
+#endif
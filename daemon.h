@@ -0,0 +1,21 @@
+#ifndef DAEMON_H_INCLUDED
+#define DAEMON_H_INCLUDED
+
+// Daemon mode: "tuo daemon [socket <path>] [prefix <dir>] [_<suffix> ...] [no-cards-cache]" loads the data
+// once (see load_data()), then reads requests from stdin, or from the clients of the Unix domain socket <path>
+// one at a time, until EOF or a "quit" line. A request is a line with the arguments of a tuo command (decks,
+// flags and operations; quote the ones with spaces with "..."); without its own "prefix" or "_<suffix>" flags
+// it gets the daemon's, and with other ones run() loads that data again. Every request runs in a child process forked
+// from the daemon, so that it gets the loaded data as it is; its output is streamed back as lines of JSON:
+//   {"ready":true,"cards":<num>,"deck_names":<num>}                             when the data is loaded
+//   {"id":<num>,"stream":"stdout"|"stderr","line":"<text>"}                      output of request #<num>
+//   {"id":<num>,"done":true,"exit_status":<num>[,"result":{"points":...,...}]}  end of request #<num>
+// (Unix only.)
+int run_daemon(int argc, char** argv);
+
+struct TuoData;
+// One session of run_daemon() on the loaded <data>: the requests read from in_fd until EOF or "quit",
+// the JSON lines written to out_fd (the ready line first). False on "quit".
+bool serve_daemon_requests(TuoData& data, int in_fd, int out_fd);
+
+#endif
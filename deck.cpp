@@ -1,8 +1,10 @@
 #include "deck.h"
 
-#include <boost/range/algorithm_ext/insert.hpp>
+#include <algorithm>
+#include <boost/regex.hpp>
 #include <boost/tokenizer.hpp>
 #include <iostream>
+#include <cmath>
 #include <iomanip>
 #include <fstream>
 #include <sstream>
@@ -13,22 +15,18 @@
 #include "read.h"
 #include "sim.h"
 
-	template<class RandomAccessIterator, class UniformRandomNumberGenerator>
+	template<class RandomAccessIterator>
 void partial_shuffle(RandomAccessIterator first, RandomAccessIterator middle,
 		RandomAccessIterator last,
-		UniformRandomNumberGenerator&& g)
+		RandomEngine& re)
 {
 	typedef typename std::iterator_traits<RandomAccessIterator>::difference_type diff_t;
-	typedef typename std::make_unsigned<diff_t>::type udiff_t;
-	typedef typename std::uniform_int_distribution<udiff_t> distr_t;
-	typedef typename distr_t::param_type param_t;
 
-	distr_t D;
 	diff_t m = middle - first;
 	diff_t n = last - first;
 	for (diff_t i = 0; i < m; ++i)
 	{
-		std::swap(first[i], first[D(g, param_t(i, n-1))]);
+		std::swap(first[i], first[re.uniform(i, n-1)]);
 	}
 }
 
@@ -375,7 +373,7 @@ std::string Deck::hash() const
 	deck_all_cards.emplace_back(commander);
 	if (alpha_dominion) { deck_all_cards.emplace_back(alpha_dominion); }
 	deck_all_cards.insert(deck_all_cards.end(), cards.begin(), cards.end());
-	if (strategy == DeckStrategy::random || strategy == DeckStrategy::flexible || strategy == DeckStrategy::evaluate || strategy == DeckStrategy::evaluate_twice)
+	if (strategy == DeckStrategy::random || strategy == DeckStrategy::flexible || strategy == DeckStrategy::flexible_adaptive || strategy == DeckStrategy::evaluate || strategy == DeckStrategy::evaluate_twice)
 	{
 		std::sort(deck_all_cards.end() - cards.size(), deck_all_cards.end(), [](const Card* a, const Card* b) { return a->m_id < b->m_id; });
 	}
@@ -549,6 +547,181 @@ Deck* Deck::clone() const
 	return(new Deck(*this));
 }
 
+//------------------------------------------------------------------------------
+inline void hash_combine(uint64_t& h, uint64_t value)
+{
+	h ^= value + 0x9E3779B97F4A7C15ull + (h << 6) + (h >> 2);
+}
+
+inline void hash_unit(uint64_t& h, const CardStatus* status)
+{
+	hash_combine(h, status->m_card->m_id);
+	hash_combine(h, status->m_hp);
+	hash_combine(h, status->m_delay);
+	hash_combine(h, status->m_absorption);
+	hash_combine(h, status->m_perm_health_buff);
+	hash_combine(h, status->m_perm_attack_buff);
+	hash_combine(h, (uint64_t)(int64_t)status->m_temp_attack_buff);
+	hash_combine(h, status->m_corroded_rate);
+	hash_combine(h, status->m_subdued);
+	hash_combine(h, status->m_enfeebled);
+	hash_combine(h, status->m_evaded);
+	hash_combine(h, status->m_inhibited);
+	hash_combine(h, status->m_sabotaged);
+	hash_combine(h, status->m_poisoned);
+	hash_combine(h, status->m_protected);
+	hash_combine(h, status->m_enraged);
+	hash_combine(h, status->m_entrapped);
+	hash_combine(h, status->m_marked);
+	hash_combine(h, status->m_diseased);
+	hash_combine(h, status->m_jammed | (status->m_overloaded << 1) | (status->m_sundered << 2));
+	for (unsigned i(0); i < status->m_num_skill_states; ++i)
+	{
+		const CardSkillState& state = status->m_skill_states[i];
+		hash_combine(h, state.m_id | (state.m_cd << 8) | ((uint64_t)(unsigned char)state.m_evolved_offset << 24)
+			| ((uint64_t)state.m_enhanced_value << 32));
+	}
+}
+
+// the state that the rollouts of a decision start from: the candidates (the first 3 cards of the active
+// deck, in order), the rest of the active deck (as a multiset for flexible, whose rollouts shuffle it all;
+// in order for evaluate, whose rollouts only shuffle the next card in), the inactive deck as a multiset
+// (shuffled by the rollouts of both), and both boards with exact hp
+uint64_t DecisionCache::key(const Field* f, DeckStrategy::DeckStrategy strategy) const
+{
+	uint64_t h = strategy;
+	hash_combine(h, f->tapi);
+	hash_combine(h, f->turn);
+	hash_combine(h, (strategy == DeckStrategy::flexible) ? f->flexible_iter : f->eval_iter);
+	// multisets: the sum of the mixed ids (in any order)
+	auto card_multiset = [](CardQueue::const_iterator begin, CardQueue::const_iterator end) {
+		uint64_t sum(0);
+		for (auto card = begin; card != end; ++card)
+		{
+			uint64_t id = (*card)->m_id;
+			sum += splitmix64(id);
+		}
+		return sum;
+	};
+	const CardQueue& active_cards(f->tap->deck->shuffled_cards);
+	const unsigned num_candidates = std::min<unsigned>(3u, active_cards.size());
+	hash_combine(h, active_cards.size());
+	for (unsigned i(0); i < num_candidates; ++i)
+	{ hash_combine(h, active_cards[i]->m_id); }
+	if (strategy == DeckStrategy::flexible)
+	{ hash_combine(h, card_multiset(active_cards.begin() + num_candidates, active_cards.end())); }
+	else
+	{
+		for (unsigned i(num_candidates); i < active_cards.size(); ++i)
+		{ hash_combine(h, active_cards[i]->m_id); }
+	}
+	const CardQueue& inactive_cards(f->tip->deck->shuffled_cards);
+	hash_combine(h, inactive_cards.size());
+	hash_combine(h, card_multiset(inactive_cards.begin(), inactive_cards.end()));
+	for (const Hand* hand: f->players)
+	{
+		hash_unit(h, &hand->commander);
+		hash_combine(h, hand->structures.size());
+		for (unsigned i(0); i < hand->structures.size(); ++i)
+		{ hash_unit(h, &const_cast<Hand*>(hand)->structures[i]); }
+		hash_combine(h, hand->assaults.size());
+		for (unsigned i(0); i < hand->assaults.size(); ++i)
+		{ hash_unit(h, &const_cast<Hand*>(hand)->assaults[i]); }
+		hash_combine(h, hand->stasis_faction_bitmap);
+		hash_combine(h, hand->total_cards_destroyed | ((uint64_t)hand->total_nonsummon_cards_destroyed << 32));
+	}
+	return splitmix64(h);
+}
+
+//------------------------------------------------------------------------------
+// Scratch battle for flexible/evaluate rollouts: decks, hands and field are
+// copied once per decision, then restored in place before every rollout.
+struct RolloutScratch
+{
+	Deck decks[2];
+	Hand hands[2];
+	Field fd;
+
+	RolloutScratch(const Field* f) :
+		decks{*f->players[0]->deck, *f->players[1]->deck},
+		hands{*f->players[0], *f->players[1]},
+		fd(*f)
+	{
+	}
+
+	// reset the scratch battle to the current state of f (both decks play randomly)
+	Field& restore(const Field* f)
+	{
+		for (unsigned p(0); p < 2; ++p)
+		{
+			decks[p].restore_battle_state(*f->players[p]->deck);
+			decks[p].strategy = DeckStrategy::random;
+			hands[p] = *f->players[p];
+			hands[p].deck = &decks[p];
+		}
+		fd.restore(*f, hands[0], hands[1]);
+		return fd;
+	}
+};
+
+// Play one flexible rollout from f with candidate #j of the active deck played first
+static uint64_t flexible_rollout(RolloutScratch& scratch, const Field* f, unsigned j)
+{
+	Field& fd(scratch.restore(f));
+	std::swap(fd.tap->deck->shuffled_cards.begin()[0],fd.tap->deck->shuffled_cards.begin()[j]);
+	std::shuffle(fd.tap->deck->shuffled_cards.begin() + 1,fd.tap->deck->shuffled_cards.end(),f->re);
+	std::shuffle(fd.tip->deck->shuffled_cards.begin(),fd.tip->deck->shuffled_cards.end(),f->re);
+	return play(&fd,true,true).points;
+}
+
+// Successive elimination over the candidates: every round plays a chunk of
+// rollouts per surviving candidate and drops the ones that are behind the
+// leader by more than two standard errors. A candidate gets at most iter
+// rollouts, so the budget never exceeds the one of the flexible strategy.
+// Returns the index of the best candidate; adds up the rollouts played.
+static unsigned choose_adaptive(const Field* f, const Deck* deck, unsigned num_candidates, unsigned iter, uint64_t& num_rollouts)
+{
+	const double z = 2.0;
+	const unsigned chunk = std::max(4u, iter / 4);
+	const double sign = (f->tapi == 0) ? 1.0 : -1.0; // enemy picks the worst result for us
+	double sum[3] = {0, 0, 0}, sum2[3] = {0, 0, 0};
+	unsigned count[3] = {0, 0, 0};
+	std::vector<unsigned> alive;
+	for (unsigned j(0); j < num_candidates; ++j)
+	{
+		bool repeat{false};
+		for (unsigned k(0); k < j; ++k)
+		{
+			if (deck->shuffled_cards[j]->m_id == deck->shuffled_cards[k]->m_id) { repeat = true; break; }
+		}
+		if (!repeat) { alive.push_back(j); }
+	}
+	if (iter == 0) { return alive[0]; } // no rollouts to compare (flexible-iter is at least 1)
+	auto mean = [&](unsigned j) { return sum[j] / count[j]; };
+	auto variance = [&](unsigned j) { return std::max(0.0, sum2[j] / count[j] - mean(j) * mean(j)); };
+	RolloutScratch scratch(f);
+	while (alive.size() > 1 && count[alive[0]] < iter)
+	{
+		for (unsigned j: alive)
+		{
+			for (unsigned i(0), n(std::min(chunk, iter - count[j])); i < n; ++i)
+			{
+				double value = sign * flexible_rollout(scratch, f, j);
+				sum[j] += value;
+				sum2[j] += value * value;
+				++ count[j];
+				++ num_rollouts;
+			}
+		}
+		unsigned best = *std::max_element(alive.begin(), alive.end(), [&](unsigned a, unsigned b) { return mean(a) < mean(b); });
+		alive.erase(std::remove_if(alive.begin(), alive.end(), [&](unsigned j) {
+			return j != best && mean(best) - mean(j) > z * std::sqrt(variance(best) / count[best] + variance(j) / count[j]);
+		}), alive.end());
+	}
+	_DEBUG_MSG(1, "Adaptive Flexible: %u candidate(s) left after %u/%u/%u rollouts\n", static_cast<unsigned>(alive.size()), count[0], count[1], count[2]);
+	return *std::max_element(alive.begin(), alive.end(), [&](unsigned a, unsigned b) { return mean(a) < mean(b); });
+}
+
 const Card* Deck::next(Field* f)
 {
 	if (shuffled_cards.empty())
@@ -606,54 +779,34 @@ const Card* Deck::next(Field* f)
 			shuffled_cards.pop_front();
 			return(card);
 		}
-		for(unsigned j =0; j < res.size();j++)
+		if (f->decision_cache) { ++ f->decision_cache->decisions; }
+		DecisionCache* cache = (f->decision_cache && f->decision_cache->enabled()) ? f->decision_cache : nullptr;
+		uint64_t cache_key = cache ? cache->key(f, strategy) : 0;
+		if (!cache || !cache->find(cache_key, res))
 		{
-			bool repeat{false};
-			for(unsigned k=0;k<j;++k) //check previous flex sims
+			RolloutScratch scratch(f);
+			for(unsigned j =0; j < res.size();j++)
 			{
-				if(shuffled_cards.begin()[j]->m_id==shuffled_cards.begin()[k]->m_id)
+				bool repeat{false};
+				for(unsigned k=0;k<j;++k) //check previous flex sims
 				{
-					res[j]=res[k]; //copy prev result
-					repeat=true;
-					break;
+					if(shuffled_cards.begin()[j]->m_id==shuffled_cards.begin()[k]->m_id)
+					{
+						res[j]=res[k]; //copy prev result
+						repeat=true;
+						break;
+					}
 				}
+				if(repeat)continue; //skip resim
+				for(unsigned i =0; i < iter;i++)
+				{
+					// restore hands, decks & field, play j first and randomize all following cards
+					//// randomize 2 remaining + 1 random card instead: worse results
+					res[j]+=flexible_rollout(scratch, f, j);
+				}
+				if (f->decision_cache) { f->decision_cache->rollouts += iter; }
 			}
-			if(repeat)continue; //skip resim
-			for(unsigned i =0; i < iter;i++)
-			{
-				//copy hand
-				Hand hand1(*f->players[0]);
-				//hand1.deck=hand1.deck->clone();
-				Hand hand2(*f->players[1]);
-				//hand2.deck = hand2.deck->clone();
-				Deck deck1(*hand1.deck);
-				Deck deck2(*hand2.deck);
-				hand1.deck = &deck1;
-				hand2.deck = &deck2;
-				hand1.deck->strategy = DeckStrategy::random;
-				hand2.deck->strategy = DeckStrategy::random;
-
-				//copy Field
-				Field fd(*f);
-				fd.players = {{&hand1,&hand2}};
-				fd.tap = fd.players[fd.tapi];
-				fd.tip = fd.players[fd.tipi];
-				fd.selection_array.clear();
-				fd.skill_queue.clear();
-				fd.killed_units.clear();
-				fd.damaged_units_to_times.clear();
-
-				std::swap(fd.tap->deck->shuffled_cards.begin()[0],fd.tap->deck->shuffled_cards.begin()[j]);
-				// randomize all following cards
-				std::shuffle(++fd.tap->deck->shuffled_cards.begin(),fd.tap->deck->shuffled_cards.end(),f->re);
-				//// randomize 2 remaining + 1 random card // worse results
-				//unsigned resplusone = std::min<unsigned>(4u,shuffled_cards.size());
-				//std::shuffle(++fd.tap->deck->shuffled_cards.begin(),fd.tap->deck->shuffled_cards.begin()+resplusone,f->re);
-				std::shuffle(fd.tip->deck->shuffled_cards.begin(),fd.tip->deck->shuffled_cards.end(),f->re);
-
-				Results<uint64_t> result(play(&fd,true,true));
-				res[j]+=result.points;
-			}
+			if (cache) { cache->insert(cache_key, res); }
 		}
 
 		_DEBUG_MSG(1,"<<<<FLEX SIMS<<<<\n");
@@ -664,6 +817,35 @@ const Card* Deck::next(Field* f)
 		shuffled_cards.pop_front();
 		return(card);
 	}
+	else if (strategy == DeckStrategy::flexible_adaptive)
+	{
+		unsigned num_candidates = std::min<unsigned>(3u, shuffled_cards.size());
+		bool all_same{true};
+		for(unsigned j =1; j < num_candidates;j++)
+		{
+			if(shuffled_cards.begin()[0]->m_id!=shuffled_cards.begin()[j]->m_id)
+			{
+				all_same=false;
+				break;
+			}
+		}
+		if(!all_same && f->flexible_turn*2>=f->turn)
+		{
+			_DEBUG_MSG(1,">>>>ADAPTIVE FLEX SIMS>>>>\n");
+			uint64_t num_rollouts(0);
+			unsigned best_j = choose_adaptive(f, this, num_candidates, f->flexible_iter, num_rollouts);
+			if (f->decision_cache)
+			{
+				++ f->decision_cache->decisions;
+				f->decision_cache->rollouts += num_rollouts;
+			}
+			_DEBUG_MSG(1,"<<<<ADAPTIVE FLEX SIMS<<<<\n");
+			std::swap(shuffled_cards.begin()[0],shuffled_cards.begin()[best_j]);
+		}
+		const Card* card = shuffled_cards.front();
+		shuffled_cards.pop_front();
+		return(card);
+	}
 	else if (strategy == DeckStrategy::evaluate || strategy == DeckStrategy::evaluate_twice)
 	{
 		_DEBUG_MSG(1,">>>>EVAL%i SIMS>>>>\n",strategy);
@@ -686,65 +868,54 @@ const Card* Deck::next(Field* f)
 			return(card);
 		}
 		_DEBUG_MSG(1, ">>EVAL%i List: (%s , %s , %s )\n",strategy,shuffled_cards[0]->m_name.c_str(),res.size()>1?shuffled_cards[1]->m_name.c_str():"", res.size()>2?shuffled_cards[2]->m_name.c_str():"");
-		for(unsigned j =0; j < res.size();j++)
+		if (f->decision_cache) { ++ f->decision_cache->decisions; }
+		DecisionCache* cache = (f->decision_cache && f->decision_cache->enabled()) ? f->decision_cache : nullptr;
+		uint64_t cache_key = cache ? cache->key(f, strategy) : 0;
+		if (!cache || !cache->find(cache_key, res))
 		{
-			bool repeat{false};
-			for(unsigned k=0;k<j;++k) //check previous flex sims
+			RolloutScratch scratch(f);
+			for(unsigned j =0; j < res.size();j++)
 			{
-				if(shuffled_cards.begin()[j]->m_id==shuffled_cards.begin()[k]->m_id)
+				bool repeat{false};
+				for(unsigned k=0;k<j;++k) //check previous flex sims
 				{
-					res[j]=res[k]; //copy prev result
-					repeat=true;
-					break;
+					if(shuffled_cards.begin()[j]->m_id==shuffled_cards.begin()[k]->m_id)
+					{
+						res[j]=res[k]; //copy prev result
+						repeat=true;
+						break;
+					}
 				}
-			}
-			if(repeat)continue; //skip resim
-			for(unsigned i =0; i < iter;i++)
-			{
-				//copy hand
-				Hand hand1(*f->players[0]);
-				//hand1.deck=hand1.deck->clone();
-				Hand hand2(*f->players[1]);
-				//hand2.deck = hand2.deck->clone();
-				Deck deck1(*hand1.deck);
-				Deck deck2(*hand2.deck);
-				hand1.deck = &deck1;
-				hand2.deck = &deck2;
-				hand1.deck->strategy = DeckStrategy::random;
-				hand2.deck->strategy = DeckStrategy::random;
-				
-
-				//copy Field
-				Field fd(*f);
-				fd.players = {{&hand1,&hand2}};
-				fd.tap = fd.players[fd.tapi];
-				fd.tip = fd.players[fd.tipi];
-				fd.selection_array.clear();
-				fd.skill_queue.clear();
-				fd.killed_units.clear();
-				fd.damaged_units_to_times.clear();
-				fd.eval_iter =1;
-
-				std::swap(fd.tap->deck->shuffled_cards.begin()[0],fd.tap->deck->shuffled_cards.begin()[j]);
-				// randomize all following cards
-				//std::shuffle(++fd.tap->deck->shuffled_cards.begin(),fd.tap->deck->shuffled_cards.end(),f->re);
-				// randomize 2 remaining + 1 random card // worse results
-				unsigned resplusone = std::min<unsigned>(4u,shuffled_cards.size());
-				std::shuffle(++fd.tap->deck->shuffled_cards.begin(),fd.tap->deck->shuffled_cards.begin()+resplusone,f->re);
-				std::shuffle(fd.tip->deck->shuffled_cards.begin(),fd.tip->deck->shuffled_cards.end(),f->re);
-
-				Results<uint64_t> result(play(&fd,true,true,1));
-				if (result.wins == 0 && result.losses ==0 && strategy == DeckStrategy::evaluate_twice) {
-					_DEBUG_MSG(1,">>>>>>EVAL%i SIMS>>>>>>\n",strategy);
-					if(f->players[0]->deck->strategy==DeckStrategy::evaluate_twice)hand1.deck->strategy = DeckStrategy::evaluate;
-					else hand1.deck->strategy = DeckStrategy::random;
-					if(f->players[1]->deck->strategy==DeckStrategy::evaluate_twice)hand2.deck->strategy = DeckStrategy::evaluate;
-					else hand2.deck->strategy = DeckStrategy::random;
-					result=(play(&fd,true,false,1));
-					_DEBUG_MSG(1,"<<<<<<EVAL%i SIMS<<<<<<\n",strategy);
+				if(repeat)continue; //skip resim
+				for(unsigned i =0; i < iter;i++)
+				{
+					//restore hands, decks & field
+					Field& fd(scratch.restore(f));
+					fd.eval_iter =1;
+
+					std::swap(fd.tap->deck->shuffled_cards.begin()[0],fd.tap->deck->shuffled_cards.begin()[j]);
+					// randomize all following cards
+					//std::shuffle(++fd.tap->deck->shuffled_cards.begin(),fd.tap->deck->shuffled_cards.end(),f->re);
+					// randomize 2 remaining + 1 random card // worse results
+					unsigned resplusone = std::min<unsigned>(4u,shuffled_cards.size());
+					std::shuffle(fd.tap->deck->shuffled_cards.begin() + 1,fd.tap->deck->shuffled_cards.begin()+resplusone,f->re);
+					std::shuffle(fd.tip->deck->shuffled_cards.begin(),fd.tip->deck->shuffled_cards.end(),f->re);
+
+					Results<uint64_t> result(play(&fd,true,true,1));
+					if (result.wins == 0 && result.losses ==0 && strategy == DeckStrategy::evaluate_twice) {
+						_DEBUG_MSG(1,">>>>>>EVAL%i SIMS>>>>>>\n",strategy);
+						if(f->players[0]->deck->strategy==DeckStrategy::evaluate_twice)scratch.decks[0].strategy = DeckStrategy::evaluate;
+						else scratch.decks[0].strategy = DeckStrategy::random;
+						if(f->players[1]->deck->strategy==DeckStrategy::evaluate_twice)scratch.decks[1].strategy = DeckStrategy::evaluate;
+						else scratch.decks[1].strategy = DeckStrategy::random;
+						result=(play(&fd,true,false,1));
+						_DEBUG_MSG(1,"<<<<<<EVAL%i SIMS<<<<<<\n",strategy);
+					}
+					res[j]+=(1-2*result.draws)*result.points;
 				}
-				res[j]+=(1-2*result.draws)*result.points;
+				if (f->decision_cache) { f->decision_cache->rollouts += iter; }
 			}
+			if (cache) { cache->insert(cache_key, res); }
 		}
 
 		_DEBUG_MSG(1,"<<<<EVAL%i SIMS<<<<\n",strategy);
@@ -759,15 +930,14 @@ const Card* Deck::next(Field* f)
 	throw std::runtime_error("Unknown strategy for deck.");
 }
 
-const Card* Deck::upgrade_card(const Card* card, unsigned card_max_level, std::mt19937& re, unsigned &remaining_upgrade_points, unsigned &remaining_upgrade_opportunities)
+const Card* Deck::upgrade_card(const Card* card, unsigned card_max_level, RandomEngine& re, unsigned &remaining_upgrade_points, unsigned &remaining_upgrade_opportunities)
 {
 	unsigned oppos = card_max_level - card->m_level;
 	if (remaining_upgrade_points > 0)
 	{
 		for (; oppos > 0; -- oppos)
 		{
-			std::mt19937::result_type rnd = re();
-			if (rnd % remaining_upgrade_opportunities < remaining_upgrade_points)
+			if (re.bounded(remaining_upgrade_opportunities) < remaining_upgrade_points)
 			{
 				card = card->upgraded();
 				-- remaining_upgrade_points;
@@ -778,13 +948,11 @@ const Card* Deck::upgrade_card(const Card* card, unsigned card_max_level, std::m
 	return card;
 }
 
-void Deck::shuffle(std::mt19937& re)
+void Deck::shuffle(RandomEngine& re)
 {
 	shuffled_commander = commander;
-	shuffled_forts.clear();
-	boost::insert(shuffled_forts, shuffled_forts.end(), fortress_cards);
-	shuffled_cards.clear();
-	boost::insert(shuffled_cards, shuffled_cards.end(), cards);
+	shuffled_forts.assign(fortress_cards.begin(), fortress_cards.end());
+	shuffled_cards.assign(cards.begin(), cards.end());
 	if (!variable_forts.empty())
 	{
 		if (decktype == DeckType::raid && strategy != DeckStrategy::random)
@@ -826,10 +994,9 @@ void Deck::shuffle(std::mt19937& re)
 	if (upgrade_points > 0)
 	{
 		unsigned remaining_upgrade_points = upgrade_points;
-		std::vector<std::pair<std::deque<const Card*>*, unsigned>> up_cards;
-		std::deque<const Card*> commander_storage;
-		commander_storage.emplace_back(shuffled_commander);
-		up_cards.emplace_back(&commander_storage, 0);
+		auto& up_cards = upgrade_slots;
+		up_cards.clear();
+		up_cards.emplace_back(nullptr, 0);
 		for (unsigned index(0); index < shuffled_forts.size(); ++ index)
 		{ up_cards.emplace_back(&shuffled_forts, index); }
 		for (unsigned index(0); index < shuffled_cards.size(); ++ index)
@@ -838,20 +1005,19 @@ void Deck::shuffle(std::mt19937& re)
 		// distribute upgrade points randomly (no gaussian/poisson distribution)
 		while (remaining_upgrade_points && up_cards.size())
 		{
-			unsigned idx = re() % up_cards.size();
-			std::pair<std::deque<const Card*>*, unsigned> x_pair = up_cards.at(idx);
-			std::deque<const Card*>* storage_ptr = x_pair.first;
+			unsigned idx = re.bounded(up_cards.size());
+			std::pair<CardQueue*, unsigned> x_pair = up_cards.at(idx);
+			CardQueue* storage_ptr = x_pair.first;
 			unsigned storage_idx = x_pair.second;
-			const Card* card = storage_ptr->at(storage_idx);
+			const Card*& card = storage_ptr ? (*storage_ptr)[storage_idx] : shuffled_commander;
 			if (card->is_top_level_card())
 			{
 				up_cards.erase(up_cards.begin() + idx);
 				continue;
 			}
-			(*storage_ptr)[storage_idx] = card->upgraded();
+			card = card->upgraded();
 			-- remaining_upgrade_points;
 		}
-		shuffled_commander = commander_storage[0];
 	}
 	if (strategy == DeckStrategy::ordered)
 	{
@@ -865,8 +1031,8 @@ void Deck::shuffle(std::mt19937& re)
 	}
 	if (strategy != DeckStrategy::exact_ordered)
 	{
-		std::deque<const Card*>* pools[] = { &shuffled_forts, &shuffled_cards };
-		for (std::deque<const Card*>* pool : pools)
+		CardQueue* pools[] = { &shuffled_forts, &shuffled_cards };
+		for (CardQueue* pool : pools)
 		{
 			auto shufflable_iter = pool->begin();
 			for (auto hand_card_id: given_hand)
@@ -916,12 +1082,105 @@ void Deck::place_at_bottom(const Card* card)
 
 void Decks::add_deck(Deck* deck, const std::string& deck_name)
 {
-	by_name[deck_name] = deck;
-	by_name[simplify_name(deck_name)] = deck;
+	for (const std::string& name: {deck_name, simplify_name(deck_name)})
+	{
+		if (building != not_building)
+		{
+			// only the names still indexed to the decks being built
+			auto lazy_it = lazy_by_name.find(name);
+			if ((lazy_it == lazy_by_name.end()) || (lazy_it->second != building)) { continue; }
+		}
+		else
+		{
+			if (lazy_by_name.erase(name) == 0 && by_name.count(name) == 0) { names_by_regex.clear(); }
+		}
+		by_name[name] = deck;
+	}
+}
+
+void Decks::add_lazy_decks(const std::vector<std::string>& deck_names, std::function<void()> build)
+{
+	unsigned index(lazy_decks.size());
+	lazy_decks.push_back({{}, build});
+	for (const auto& deck_name: deck_names)
+	{
+		for (const std::string& name: {deck_name, simplify_name(deck_name)})
+		{
+			lazy_decks.back().names.push_back(name);
+			by_name.erase(name);
+			lazy_by_name[name] = index;
+		}
+	}
+	names_by_regex.clear();
 }
 
 Deck* Decks::find_deck_by_name(const std::string& deck_name)
+{
+	const std::string name(simplify_name(deck_name));
+	auto it = by_name.find(name);
+	if (it != by_name.end()) { return it->second; }
+	auto lazy_it = lazy_by_name.find(name);
+	if (lazy_it == lazy_by_name.end()) { return nullptr; }
+
+	// build them: their names that are not added (the decks failed, or build() threw) are dropped
+	building = lazy_it->second;
+	LazyDecks& lazy(lazy_decks[building]);
+	auto build = std::move(lazy.build);
+	lazy.build = nullptr;
+	auto drop_lazy_names = [this, &lazy]() {
+		for (const auto& lazy_name: lazy.names)
+		{
+			auto name_it = lazy_by_name.find(lazy_name);
+			if ((name_it != lazy_by_name.end()) && (name_it->second == building))
+			{
+				lazy_by_name.erase(name_it);
+				if (by_name.count(lazy_name) == 0) { names_by_regex.clear(); }
+			}
+		}
+		lazy.names.clear();
+		building = not_building;
+	};
+	try
+	{
+		build();
+	}
+	catch (...)
+	{
+		drop_lazy_names();
+		throw;
+	}
+	drop_lazy_names();
+	it = by_name.find(name);
+	return it == by_name.end() ? nullptr : it->second;
+}
+
+bool Decks::has_deck_name(const std::string& deck_name) const
+{
+	const std::string name(simplify_name(deck_name));
+	return by_name.count(name) > 0 || lazy_by_name.count(name) > 0;
+}
+
+const Deck* Decks::find_built_deck_by_name(const std::string& deck_name) const
 {
 	auto it = by_name.find(simplify_name(deck_name));
 	return it == by_name.end() ? nullptr : it->second;
 }
+
+const std::vector<std::string>& Decks::find_deck_names(const std::string& regex_string)
+{
+	auto cached_it = names_by_regex.find(regex_string);
+	if (cached_it != names_by_regex.end()) { return cached_it->second; }
+	boost::regex regex(regex_string);
+	boost::smatch smatch;
+	std::vector<std::string> names;
+	for (const auto& deck_it: by_name)
+	{
+		if (boost::regex_search(deck_it.first, smatch, regex)) { names.push_back(deck_it.first); }
+	}
+	for (const auto& lazy_it: lazy_by_name)
+	{
+		if (boost::regex_search(lazy_it.first, smatch, regex)) { names.push_back(lazy_it.first); }
+	}
+	std::sort(names.begin(), names.end());
+	return names_by_regex[regex_string] = names;
+}
@@ -2,10 +2,12 @@
 #define DECK_H_INCLUDED
 
 #include <deque>
+#include <functional>
 #include <list>
 #include <map>
 #include <random>
 #include <set>
+#include <string>
 #include <vector>
 
 #include "tyrant.h"
@@ -28,9 +30,15 @@ enum DeckStrategy
     flexible,
     evaluate,
     evaluate_twice,
+    flexible_adaptive,
     num_deckstrategies
 };
 }
+// strategies that play the cards in no set order (the order of the cards in the deck does not matter)
+inline bool is_random_strategy(DeckStrategy::DeckStrategy strategy)
+{
+    return (strategy == DeckStrategy::random) || (strategy == DeckStrategy::flexible) || (strategy == DeckStrategy::flexible_adaptive);
+}
 typedef void (*DeckDecoder)(const char* hash, std::vector<unsigned>& ids);
 typedef void (*DeckEncoder)(std::stringstream &ios, std::vector<const Card*> cards);
 void hash_to_ids_wmt_b64(const char* hash, std::vector<unsigned>& ids);
@@ -42,6 +50,67 @@ void encode_deck_ddd_b64(std::stringstream &ios, std::vector<const Card*> cards)
 extern DeckDecoder hash_to_ids;
 extern DeckEncoder encode_deck;
 
+//------------------------------------------------------------------------------
+// Cards of a shuffled deck, drawn from the front: a vector plus a head index.
+// Refilling keeps the capacity, so reshuffling a warm deck does not allocate.
+class CardQueue
+{
+public:
+    typedef const Card* value_type;
+    typedef const Card** iterator;
+    typedef const Card* const* const_iterator;
+
+    CardQueue() :
+        m_head(0)
+    {
+    }
+
+    inline iterator begin() { return(m_cards.data() + m_head); }
+    inline iterator end() { return(m_cards.data() + m_cards.size()); }
+    inline const_iterator begin() const { return(m_cards.data() + m_head); }
+    inline const_iterator end() const { return(m_cards.data() + m_cards.size()); }
+    inline unsigned size() const { return(m_cards.size() - m_head); }
+    inline bool empty() const { return(m_head == m_cards.size()); }
+    inline const Card*& operator[](unsigned i) { return(m_cards[m_head + i]); }
+    inline const Card* operator[](unsigned i) const { return(m_cards[m_head + i]); }
+    inline const Card* front() const { return(m_cards[m_head]); }
+
+    inline void pop_front() { ++ m_head; }
+    inline void push_back(const Card* card) { m_cards.push_back(card); }
+    inline void erase(iterator pos) { m_cards.erase(m_cards.begin() + (pos - m_cards.data())); }
+    inline void clear() { m_cards.clear(); m_head = 0; }
+
+    // append [first, last)
+    template<typename Iter>
+    inline void insert(iterator pos, Iter first, Iter last)
+    {
+        _DEBUG_ASSERT(pos == end());
+        m_cards.insert(m_cards.end(), first, last);
+    }
+
+    template<typename Iter>
+    inline void assign(Iter first, Iter last)
+    {
+        m_cards.assign(first, last);
+        m_head = 0;
+    }
+
+private:
+    std::vector<const Card*> m_cards;
+    unsigned m_head;
+};
+
+//------------------------------------------------------------------------------
+// Deck::shuffle() scratch: the upgradable slots (queue, index; nullptr: commander).
+// They point into the deck's own queues, so a copied deck starts without any.
+class UpgradeSlots : public std::vector<std::pair<CardQueue*, unsigned>>
+{
+public:
+    UpgradeSlots() {}
+    UpgradeSlots(const UpgradeSlots&) {}
+    UpgradeSlots& operator=(const UpgradeSlots&) { clear(); return *this; }
+};
+
 //------------------------------------------------------------------------------
 // No support for ordered raid decks
 class Deck
@@ -62,8 +131,9 @@ public:
     std::map<signed, char> card_marks;  // <positions of card, prefix mark>: -1 indicating the commander. E.g, used as a mark to be kept in attacking deck when optimizing.
 
     const Card* shuffled_commander;
-    std::deque<const Card*> shuffled_forts;
-    std::deque<const Card*> shuffled_cards;
+    CardQueue shuffled_forts;
+    CardQueue shuffled_cards;
+    UpgradeSlots upgrade_slots;  // shuffle() scratch (not copied)
 
     // card id -> card order
     std::map<unsigned, std::list<unsigned>> order;
@@ -143,26 +213,117 @@ public:
     void add_dominion(const Card* dom_card, bool override_dom);
 
     Deck* clone() const;
+    // copy the state that play() changes (the rest of a deck is read-only during a battle)
+    void restore_battle_state(const Deck& src)
+    {
+        strategy = src.strategy;
+        shuffled_cards.assign(src.shuffled_cards.begin(), src.shuffled_cards.end());
+    }
     std::string hash() const;
     std::string short_description() const;
     std::string medium_description() const;
     std::string long_description() const;
     void show_upgrades(std::stringstream &ios, const Card* card, unsigned card_max_level, const char * leading_chars) const;
     const Card* next(Field* f);
-    const Card* upgrade_card(const Card* card, unsigned card_max_level, std::mt19937& re, unsigned &remaining_upgrade_points, unsigned &remaining_upgrade_opportunities);
-    void shuffle(std::mt19937& re);
+    const Card* upgrade_card(const Card* card, unsigned card_max_level, RandomEngine& re, unsigned &remaining_upgrade_points, unsigned &remaining_upgrade_opportunities);
+    void shuffle(RandomEngine& re);
     void place_at_bottom(const Card* card);
 };
 
+//---------------------- Rollout decision cache --------------------------------
+// Per-thread cache of flexible/evaluate decisions (see Deck::next()).
+// Maps a hash of the decision state (turn, candidates, remaining libraries, boards with exact hp
+// and statuses; see key()) to the accumulated rollout scores of the candidates; direct-mapped, fixed size.
+// The decks are not in the key: the owner clears the cache when it sims another deck pair.
+// Also counts decisions and rollouts of all rollout-based strategies.
+class DecisionCache
+{
+public:
+    DecisionCache(unsigned capacity = 0) :
+        hits(0),
+        misses(0),
+        decisions(0),
+        rollouts(0),
+        m_entries(capacity)
+    {
+    }
+
+    bool enabled() const { return !m_entries.empty(); }
+    void clear()
+    {
+        for (Entry& entry: m_entries) { entry.size = 0; }
+    }
+    uint64_t key(const Field* f, DeckStrategy::DeckStrategy strategy) const;
+
+    template<typename T>
+    bool find(uint64_t key, std::vector<T>& res)
+    {
+        const Entry& entry = m_entries[key % m_entries.size()];
+        if (entry.key != key || entry.size != res.size())
+        {
+            ++ misses;
+            return false;
+        }
+        for (unsigned j(0); j < res.size(); ++j)
+        { res[j] = static_cast<T>(entry.res[j]); }
+        ++ hits;
+        return true;
+    }
+
+    template<typename T>
+    void insert(uint64_t key, const std::vector<T>& res)
+    {
+        Entry& entry = m_entries[key % m_entries.size()];
+        entry.key = key;
+        entry.size = res.size();
+        for (unsigned j(0); j < res.size(); ++j)
+        { entry.res[j] = static_cast<int64_t>(res[j]); }
+    }
+
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t decisions;
+    uint64_t rollouts;
+
+private:
+    struct Entry
+    {
+        uint64_t key;
+        unsigned size;  // number of candidates, 0: empty slot
+        int64_t res[3];
+    };
+    std::vector<Entry> m_entries;
+};
+
 typedef std::map<std::string, long double> DeckList;
 class Decks
 {
 public:
     void add_deck(Deck* deck, const std::string& deck_name);
+    // decks only indexed by their names until one of them is looked up: build() then adds them (add_deck());
+    // a name keeps referring to the deck added (or indexed) last with it
+    void add_lazy_decks(const std::vector<std::string>& deck_names, std::function<void()> build);
     Deck* find_deck_by_name(const std::string& deck_name);
+    // no build of lazy decks: whether a deck (built or not) has that name, and the deck if it is built
+    bool has_deck_name(const std::string& deck_name) const;
+    const Deck* find_built_deck_by_name(const std::string& deck_name) const;
+    // the names (built or not) matching a regex, sorted (cached until names are added or dropped)
+    const std::vector<std::string>& find_deck_names(const std::string& regex_string);
+    size_t num_deck_names() const { return by_name.size() + lazy_by_name.size(); }
     std::list<Deck> decks;
     std::map<std::pair<DeckType::DeckType, unsigned>, Deck*> by_type_id;
     std::map<std::string, Deck*> by_name;
+private:
+    struct LazyDecks
+    {
+        std::vector<std::string> names; // and their simplified names
+        std::function<void()> build;
+    };
+    static const unsigned not_building = ~0u;
+    std::vector<LazyDecks> lazy_decks;
+    std::map<std::string, unsigned> lazy_by_name; // index in lazy_decks, names not in by_name
+    unsigned building{not_building};
+    std::map<std::string, std::vector<std::string>> names_by_regex;
 };
 
 #endif
@@ -1,9 +1,9 @@
 #include "read.h"
 
+#include <algorithm>
 #include <boost/filesystem.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/tokenizer.hpp>
-#include <boost/regex.hpp>
 #include <cstring>
 #include <map>
 #include <unordered_set>
@@ -102,18 +102,24 @@ DeckList expand_deck_to_list(std::string deck_name, Decks& decks)
         // deck_name is, or refers to, a regex
         DeckList res;
         std::string regex_string(deck_string, 1, deck_string.length() - 2);
-        boost::regex regex(regex_string);
-        boost::smatch smatch;
         expanding_decks.insert(deck_name);
-        for (const auto & deck_it: decks.by_name)
+        const std::vector<std::string> deck_names(decks.find_deck_names(regex_string));
+        for (const auto & matched_name: deck_names)
         {
-            if (boost::regex_search(deck_it.first, smatch, regex))
+            // the lazy decks (missions, raids, custom decks) that fail to build are skipped
+            try
             {
-                auto && decklist = expand_deck_to_list(deck_it.first, decks);
-                for (const auto & it : decklist)
-                {
-                    res[it.first] += it.second;
-                }
+                if (decks.find_deck_by_name(matched_name) == nullptr) { continue; }
+            }
+            catch (const std::exception& e)
+            {
+                std::cerr << "WARNING: Skip deck " << matched_name << " matching /" << regex_string << "/: " << e.what() << std::endl;
+                continue;
+            }
+            auto && decklist = expand_deck_to_list(matched_name, decks);
+            for (const auto & it : decklist)
+            {
+                res[it.first] += it.second;
             }
         }
         expanding_decks.erase(deck_name);
@@ -163,43 +169,42 @@ DeckList parse_deck_list(std::string list_string, Decks& decks)
 
 void parse_card_spec(const Cards& all_cards, const std::string& card_spec, unsigned& card_id, unsigned& card_num, char& num_sign, char& mark)
 {
-//    static std::set<std::string> recognized_abbr;
-    auto card_spec_iter = card_spec.begin();
+    // Name lookups go through the hash table of all_cards (simplifying on the fly), so that a known card does not allocate.
     card_id = 0;
     card_num = 1;
     num_sign = 0;
     mark = 0;
-    std::string card_name;
-    card_spec_iter = read_token(card_spec_iter, card_spec.end(), [](char c){return(c=='#' || c=='(' || c=='\r');}, card_name);
-    if(card_name[0] == '!')
+    const char* name_begin = advance_until(card_spec.data(), card_spec.data() + card_spec.size(), [](char c){return(c != ' ');});
+    const char* name_stop = advance_until(name_begin, card_spec.data() + card_spec.size(), [](char c){return(c=='#' || c=='(' || c=='\r');});
+    const char* name_end = recede_until(name_stop, name_begin, [](char c){return(c != ' ');});
+    auto card_spec_iter = card_spec.begin() + (name_stop - card_spec.data());
+    if(name_begin != name_end && *name_begin == '!')
     {
-        mark = card_name[0];
-        card_name.erase(0, 1);
+        mark = *name_begin;
+        ++ name_begin;
     }
     // If card name is not found, try find card id quoted in '[]' in name, ignoring other characters.
-    std::string simple_name{simplify_name(card_name)};
-    const auto && abbr_it = all_cards.player_cards_abbr.find(simple_name);
-    if(abbr_it != all_cards.player_cards_abbr.end())
-    {
-//        if(recognized_abbr.count(card_name) == 0)
-//        {
-//            std::cout << "Recognize abbreviation " << card_name << ": " << abbr_it->second << std::endl;
-//            recognized_abbr.insert(card_name);
-//        }
-        simple_name = simplify_name(abbr_it->second);
-    }
-    auto card_it = all_cards.cards_by_name.find(simple_name);
-    auto card_id_iter = advance_until(simple_name.begin(), simple_name.end(), [](char c){return(c=='[');});
-    if (card_it != all_cards.cards_by_name.end())
-    {
-        card_id = card_it->second->m_id;
-        if (all_cards.ambiguous_names.count(simple_name))
+    const Cards::NameSlot* name_slot = all_cards.find_name(name_begin, name_end);
+    const char* simple_begin = name_begin;
+    const char* simple_end = name_end;
+    if(name_slot && name_slot->abbr)
+    {
+        simple_begin = name_slot->abbr->data();
+        simple_end = simple_begin + name_slot->abbr->size();
+        name_slot = all_cards.find_name(simple_begin, simple_end);
+    }
+    if (name_slot && name_slot->card)
+    {
+        card_id = name_slot->card->m_id;
+        if (name_slot->ambiguous)
         {
-            std::cerr << "WARNING: There are multiple cards named " << card_name << " in cards.xml. [" << card_id << "] is used.\n";
+            std::cerr << "WARNING: There are multiple cards named " << std::string{name_begin, name_end} << " in cards.xml. [" << card_id << "] is used.\n";
         }
     }
-    else if(card_id_iter != simple_name.end())
+    else if(std::find(simple_begin, simple_end, '[') != simple_end)
     {
+        std::string simple_name{simplify_name(std::string{simple_begin, simple_end})};
+        auto card_id_iter = advance_until(simple_name.begin(), simple_name.end(), [](char c){return(c=='[');});
         ++ card_id_iter;
         card_id_iter = read_token(card_id_iter, simple_name.end(), [](char c){return(c==']');}, card_id);
     }
@@ -218,7 +223,7 @@ void parse_card_spec(const Cards& all_cards, const std::string& card_spec, unsig
     }
     if(card_id == 0)
     {
-        throw std::runtime_error("Unknown card: " + card_name);
+        throw std::runtime_error("Unknown card: " + std::string{name_begin, name_end});
     }
 }
 
@@ -331,6 +336,7 @@ unsigned read_card_abbrs(Cards& all_cards, const std::string& filename)
                 all_cards.player_cards_abbr[simplify_name(abbr_name)] = std::string{abbr_string_iter, abbr_string.end()};
             }
         }
+        all_cards.index_names();
     }
     catch (std::exception& e)
     {
@@ -340,6 +346,7 @@ unsigned read_card_abbrs(Cards& all_cards, const std::string& filename)
             std::cerr << " at line " << num_line;
         }
         std::cerr << ": " << e.what() << ".\n";
+        all_cards.index_names();
         return(3);
     }
     return(0);
@@ -436,18 +443,25 @@ unsigned load_custom_decks(Decks& decks, Cards& all_cards, const std::string & f
                 continue;
             }
             deck_string_iter = advance_until(deck_string_iter + 1, deck_string.end(), [](const char& c){return(c != ' ');});
-            Deck* deck = decks.find_deck_by_name(deck_name);
-            if (deck != nullptr)
+            // not built for the check (a custom deck of an earlier line is not yet)
+            if (decks.has_deck_name(deck_name))
             {
-                std::cerr << "Warning in custom deck file " << filename << " at line " << num_line << ", name conflicts, overrides " << deck->short_description() << std::endl;
+                const Deck* deck = decks.find_built_deck_by_name(deck_name);
+                std::cerr << "Warning in custom deck file " << filename << " at line " << num_line << ", name conflicts, overrides "
+                    << (deck ? deck->short_description() : deck_name) << std::endl;
             }
-            decks.decks.push_back(Deck{all_cards, DeckType::custom_deck, num_line, deck_name});
-            deck = &decks.decks.back();
-            deck->set(std::string{deck_string_iter, deck_string.end()});
-            decks.add_deck(deck, deck_name);
+            // built when looked up (see Decks::add_lazy_decks())
             std::stringstream alt_name;
-            alt_name << decktype_names[deck->decktype] << " #" << deck->id;
-            decks.add_deck(deck, alt_name.str());
+            alt_name << decktype_names[DeckType::custom_deck] << " #" << num_line;
+            std::string alt_deck_name{alt_name.str()};
+            std::string cards_string{deck_string_iter, deck_string.end()};
+            decks.add_lazy_decks({deck_name, alt_deck_name}, [&decks, &all_cards, num_line, deck_name, alt_deck_name, cards_string]() {
+                decks.decks.push_back(Deck{all_cards, DeckType::custom_deck, num_line, deck_name});
+                Deck* deck = &decks.decks.back();
+                deck->set(cards_string);
+                decks.add_deck(deck, deck_name);
+                decks.add_deck(deck, alt_deck_name);
+            });
         }
     }
     catch (std::exception& e)
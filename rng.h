@@ -0,0 +1,138 @@
+#ifndef RNG_H_INCLUDED
+#define RNG_H_INCLUDED
+
+#include <cstdint>
+#include <random>
+
+//------------------------------------------------------------------------------
+// SplitMix64 step: used to expand a single 64-bit seed into engine state.
+inline uint64_t splitmix64(uint64_t& state)
+{
+    uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+//------------------------------------------------------------------------------
+// xoshiro256** 1.0 (Blackman & Vigna): 32 bytes of state, UniformRandomBitGenerator.
+class Xoshiro256ss
+{
+public:
+    typedef uint64_t result_type;
+
+    explicit Xoshiro256ss(uint64_t value = 0) { seed(value); }
+
+    void seed(uint64_t value)
+    {
+        for (auto& s: m_state) { s = splitmix64(value); }
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return UINT64_MAX; }
+
+    inline result_type operator()()
+    {
+        const uint64_t result = rotl(m_state[1] * 5, 7) * 9;
+        const uint64_t t = m_state[1] << 17;
+        m_state[2] ^= m_state[0];
+        m_state[3] ^= m_state[1];
+        m_state[1] ^= m_state[2];
+        m_state[0] ^= m_state[3];
+        m_state[2] ^= t;
+        m_state[3] = rotl(m_state[3], 45);
+        return result;
+    }
+
+private:
+    static inline uint64_t rotl(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+    uint64_t m_state[4];
+};
+
+//------------------------------------------------------------------------------
+// Battle RNG core (build with -DUSE_MT19937 to get the legacy generator back)
+#ifdef USE_MT19937
+typedef std::mt19937 RandomCore;
+#else
+typedef Xoshiro256ss RandomCore;
+#endif
+
+// Engine used by the simulator and the optimizer: the selected core plus
+// a fast bounded-integer routine and a buffered coin flip.
+class RandomEngine: public RandomCore
+{
+public:
+    typedef RandomCore::result_type result_type;
+
+    explicit RandomEngine(uint64_t value = 0) :
+        RandomCore(static_cast<result_type>(value)),
+        m_bits(0),
+        m_num_bits(0)
+    {
+    }
+
+    void seed(uint64_t value)
+    {
+        RandomCore::seed(static_cast<result_type>(value));
+        m_num_bits = 0;
+    }
+
+    // reseed for battle #battle_index of a run: any battle can be reproduced
+    // without replaying the ones before it
+    void seed_battle(uint64_t run_seed, uint64_t battle_index)
+    {
+        uint64_t state = run_seed;
+        uint64_t value = splitmix64(state) ^ battle_index;
+        seed(splitmix64(value));
+    }
+
+    inline uint32_t next32()
+    {
+        result_type value = (*this)();
+        return (RandomCore::max() > UINT32_MAX) ? static_cast<uint32_t>(static_cast<uint64_t>(value) >> 32) : static_cast<uint32_t>(value);
+    }
+
+    // uniform integer in [0, range) (Lemire's multiply-shift); range == 0 means full 32-bit range
+    inline uint32_t bounded(uint32_t range)
+    {
+        if (__builtin_expect(range == 0, false)) { return next32(); }
+        uint64_t m = static_cast<uint64_t>(next32()) * range;
+        uint32_t low = static_cast<uint32_t>(m);
+        if (__builtin_expect(low < range, false))
+        {
+            const uint32_t threshold = -range % range;
+            while (low < threshold)
+            {
+                m = static_cast<uint64_t>(next32()) * range;
+                low = static_cast<uint32_t>(m);
+            }
+        }
+        return static_cast<uint32_t>(m >> 32);
+    }
+
+    // uniform integer in [x, y]
+    inline unsigned uniform(unsigned x, unsigned y)
+    {
+        return x + bounded(y - x + 1);
+    }
+
+    // one random bit, taken from a buffered word
+    inline unsigned flip()
+    {
+        if (__builtin_expect(m_num_bits == 0, false))
+        {
+            m_bits = (*this)();
+            m_num_bits = (RandomCore::max() > UINT32_MAX) ? 64 : 32;
+        }
+        unsigned bit = m_bits & 1u;
+        m_bits >>= 1;
+        -- m_num_bits;
+        return bit;
+    }
+
+private:
+    uint64_t m_bits;
+    unsigned m_num_bits;
+};
+
+#endif
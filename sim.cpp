@@ -18,6 +18,7 @@ bool check_and_perform_bravery(Field* fd, CardStatus* src);
 bool check_and_perform_early_enhance(Field* fd, CardStatus* src);
 bool check_and_perform_later_enhance(Field* fd, CardStatus* src);
 CardStatus* check_and_perform_summon(Field* fd, CardStatus* src);
+inline void perform_activation_skill(Field* fd, CardStatus* src, const SkillSpec& s);
 //------------------------------------------------------------------------------
 inline unsigned remove_absorption(Field* fd, CardStatus* status, unsigned dmg);
 inline unsigned remove_absorption(CardStatus* status, unsigned dmg);
@@ -133,10 +134,80 @@ inline void Field::finalize_action()
     }
 }
 
+//------------------------------------------------------------------------------
+inline const CardSkillState* CardStatus::find_skill_state(Skill::Skill skill_id) const
+{
+    for (unsigned i(0); i < m_num_skill_states; ++ i)
+    {
+        if (m_skill_states[i].m_id == skill_id)
+        { return &m_skill_states[i]; }
+    }
+    return nullptr;
+}
+//------------------------------------------------------------------------------
+inline CardSkillState& CardStatus::skill_state(Skill::Skill skill_id)
+{
+    for (unsigned i(0); i < m_num_skill_states; ++ i)
+    {
+        if (m_skill_states[i].m_id == skill_id)
+        { return m_skill_states[i]; }
+    }
+    if (__builtin_expect(m_num_skill_states >= max_skill_states, false))
+    {
+        throw std::runtime_error("Too many skill states for " + m_card->m_name);
+    }
+    CardSkillState& state = m_skill_states[m_num_skill_states ++];
+    state.m_enhanced_value = 0;
+    state.m_cd = 0;
+    state.m_id = skill_id;
+    state.m_primary_offset = 0;
+    state.m_evolved_offset = 0;
+    return state;
+}
+//------------------------------------------------------------------------------
+inline signed CardStatus::primary_skill_offset(Skill::Skill skill_id) const
+{
+    if (__builtin_expect(!m_evolved, true)) { return 0; }
+    const CardSkillState* state = find_skill_state(skill_id);
+    return state ? state->m_primary_offset : 0;
+}
+//------------------------------------------------------------------------------
+inline signed CardStatus::evolved_skill_offset(Skill::Skill skill_id) const
+{
+    if (__builtin_expect(!m_evolved, true)) { return 0; }
+    const CardSkillState* state = find_skill_state(skill_id);
+    return state ? state->m_evolved_offset : 0;
+}
+//------------------------------------------------------------------------------
+inline unsigned CardStatus::enhanced_value(Skill::Skill skill_id) const
+{
+    if (__builtin_expect(!m_enhanced, true)) { return 0; }
+    const CardSkillState* state = find_skill_state(skill_id);
+    return state ? state->m_enhanced_value : 0;
+}
+//------------------------------------------------------------------------------
+inline unsigned CardStatus::skill_cd(Skill::Skill skill_id) const
+{
+    const CardSkillState* state = find_skill_state(skill_id);
+    return state ? state->m_cd : 0;
+}
+//------------------------------------------------------------------------------
+// Evolve/Enhance last until the end of the owner's turn; cooldowns are kept.
+inline void CardStatus::reset_skill_modifiers()
+{
+    m_evolved = false;
+    m_enhanced = false;
+    for (unsigned i(0); i < m_num_skill_states; ++ i)
+    {
+        m_skill_states[i].m_enhanced_value = 0;
+        m_skill_states[i].m_primary_offset = 0;
+        m_skill_states[i].m_evolved_offset = 0;
+    }
+}
 //------------------------------------------------------------------------------
 inline unsigned CardStatus::skill_base_value(Skill::Skill skill_id) const
 {
-    return m_card->m_skill_value[skill_id + m_primary_skill_offset[skill_id]]
+    return m_card->m_skill_value[skill_id + primary_skill_offset(skill_id)]
         + (skill_id == Skill::berserk ? m_enraged : 0)
         + (skill_id == Skill::counter ? m_entrapped : 0)
         ;
@@ -157,7 +228,7 @@ inline bool CardStatus::has_skill(Skill::Skill skill_id) const
 //------------------------------------------------------------------------------
 inline unsigned CardStatus::enhanced(Skill::Skill skill_id) const
 {
-    return m_enhanced_value[skill_id + m_primary_skill_offset[skill_id]];
+    return enhanced_value(static_cast<Skill::Skill>(skill_id + primary_skill_offset(skill_id)));
 }
 //------------------------------------------------------------------------------
 inline unsigned CardStatus::protected_value() const
@@ -223,11 +294,15 @@ inline void CardStatus::set(const Card& card)
     m_sundered = false;
     //APN
     m_summoned = false;
+    m_evolved = false;
+    m_enhanced = false;
 
-    std::memset(m_primary_skill_offset, 0, sizeof m_primary_skill_offset);
-    std::memset(m_evolved_skill_offset, 0, sizeof m_evolved_skill_offset);
-    std::memset(m_enhanced_value, 0, sizeof m_enhanced_value);
-    std::memset(m_skill_cd, 0, sizeof m_skill_cd);
+    // one zeroed slot per card skill (skill ids are unique across triggers)
+    m_num_skill_states = 0;
+    for (const auto & ss : card.m_skills) { skill_state(ss.id); }
+    for (const auto & ss : card.m_skills_on_play) { skill_state(ss.id); }
+    for (const auto & ss : card.m_skills_on_attacked) { skill_state(ss.id); }
+    for (const auto & ss : card.m_skills_on_death) { skill_state(ss.id); }
 }
 //------------------------------------------------------------------------------
 inline unsigned CardStatus::attack_power() const
@@ -376,8 +451,8 @@ std::string CardStatus::description() const
         for (const auto& ss : card_skills)
         {
             std::string skill_desc;
-            if (m_evolved_skill_offset[ss.id]) { skill_desc += "->" + skill_names[ss.id + m_evolved_skill_offset[ss.id]]; }
-            if (m_enhanced_value[ss.id]) { skill_desc += " +" + to_string(m_enhanced_value[ss.id]); }
+            if (evolved_skill_offset(ss.id)) { skill_desc += "->" + skill_names[ss.id + evolved_skill_offset(ss.id)]; }
+            if (enhanced_value(ss.id)) { skill_desc += " +" + to_string(enhanced_value(ss.id)); }
             if (!skill_desc.empty())
             {
                 desc += ", " + (
@@ -391,7 +466,7 @@ std::string CardStatus::description() const
     return desc + "]";
 }
 //------------------------------------------------------------------------------
-void Hand::reset(std::mt19937& re)
+void Hand::reset(RandomEngine& re)
 {
     assaults.reset();
     structures.reset();
@@ -444,7 +519,7 @@ SkillSpec apply_sabotage(const SkillSpec& s, unsigned sabotaged_value)
 //------------------------------------------------------------------------------
 inline void resolve_scavenge(Storage<CardStatus>& store)
 {
-    for(auto status : store.m_indirect)
+    for(auto status : store)
     {
         if(!is_alive(status))continue;
         unsigned scavenge_value = status->skill(Skill::scavenge);
@@ -567,19 +642,20 @@ void prepend_on_death(Field* fd,bool paybacked=false)
             _DEBUG_MSG(2, "Revenge: Preparing (head) skills  %s and %s\n",
                     skill_description(fd->cards, ss_heal).c_str(),
                     skill_description(fd->cards, ss_rally).c_str());
-            fd->skill_queue.emplace(fd->skill_queue.begin()+0, commander, ss_heal);
-            fd->skill_queue.emplace(fd->skill_queue.begin()+1, commander, ss_rally); // +1: keep ss_heal at first place
+            fd->skill_queue.emplace_front(commander, ss_rally);
+            fd->skill_queue.emplace_front(commander, ss_heal); // keep ss_heal at first place
         }
 
         // resolve On-Death skills
-        for (auto& ss: status->m_card->m_skills_on_death)
+        for (const auto& cs: status->m_card->m_on_death_skills)
         {
+            const SkillSpec& ss = cs.ss;
             if (__builtin_expect(skip_all_except_summon && (ss.id != Skill::summon), false))
             { continue; }
         	SkillSpec tss = ss;
             _DEBUG_MSG(2, "On Death %s: Preparing (tail) skill %s\n",
                     status_description(status).c_str(), skill_description(fd->cards, ss).c_str());
-            if(fd->fixes[Fix::revenge_on_death] && is_activation_harmful_skill(ss.id) && paybacked)
+            if(fd->fixes[Fix::revenge_on_death] && cs.harmful && paybacked)
             {
             	_DEBUG_MSG(2, "On Death Revenge Fix\n");
             	tss.s2 = Skill::revenge;
@@ -592,63 +668,97 @@ void prepend_on_death(Field* fd,bool paybacked=false)
 
 //------------------------------------------------------------------------------
 void(*skill_table[Skill::num_skills])(Field*, CardStatus* src, const SkillSpec&);
-void resolve_skill(Field* fd)
+// Apply the dynamic modifiers (evolve, sabotage, enhance) and perform the skill.
+// has_x: precomputed is_activation_skill_with_x() of the unmodified skill
+inline void perform_modified_skill(Field* fd, CardStatus* status, const SkillSpec& ss, bool has_x)
 {
-    while (!fd->skill_queue.empty())
-    {
-        auto skill_instance(fd->skill_queue.front());
-        auto& status(std::get<0>(skill_instance));
-        const auto& ss(std::get<1>(skill_instance));
-        fd->skill_queue.pop_front();
-        if (__builtin_expect(status->m_card->m_skill_trigger[ss.id] == Skill::Trigger::activate, true))
-        {
-            if (!is_alive(status))
-            {
-                _DEBUG_MSG(2, "%s failed to %s because it is dead.\n",
-                        status_description(status).c_str(), skill_description(fd->cards, ss).c_str());
-                continue;
-            }
-            if (status->m_jammed)
-            {
-                _DEBUG_MSG(2, "%s failed to %s because it is Jammed.\n",
-                        status_description(status).c_str(), skill_description(fd->cards, ss).c_str());
-                continue;
-            }
-        }
+    SkillSpec modified_s = ss;
 
-        // is summon? (non-activation skill)
-        if (ss.id == Skill::summon)
-        {
-            check_and_perform_summon(fd, status);
-            continue;
-        }
-        _DEBUG_ASSERT(is_activation_skill(ss.id) || ss.id == Skill::enhance); // enhance is no trigger, but  queues the skill
-
-        SkillSpec modified_s = ss;
-
-        // apply evolve
-        signed evolved_offset = status->m_evolved_skill_offset[modified_s.id];
-        if (evolved_offset != 0)
-        { modified_s = apply_evolve(modified_s, evolved_offset); }
+    // apply evolve
+    signed evolved_offset = status->evolved_skill_offset(modified_s.id);
+    if (evolved_offset != 0)
+    {
+        modified_s = apply_evolve(modified_s, evolved_offset);
+        has_x = is_activation_skill_with_x(modified_s.id);
+    }
 
-        // apply sabotage (only for X-based activation skills)
-        unsigned sabotaged_value = status->m_sabotaged;
-        if ((sabotaged_value > 0) && is_activation_skill_with_x(modified_s.id))
-        { modified_s = apply_sabotage(modified_s, sabotaged_value); }
+    // apply sabotage (only for X-based activation skills)
+    unsigned sabotaged_value = status->m_sabotaged;
+    if ((sabotaged_value > 0) && has_x)
+    { modified_s = apply_sabotage(modified_s, sabotaged_value); }
 
-        // apply enhance
-        unsigned enhanced_value = status->enhanced(modified_s.id);
-        if (enhanced_value > 0)
-        { modified_s = apply_enhance(modified_s, enhanced_value); }
+    // apply enhance
+    unsigned enhanced_value = status->enhanced(modified_s.id);
+    if (enhanced_value > 0)
+    { modified_s = apply_enhance(modified_s, enhanced_value); }
 
-        // perform skill (if it is still applicable)
-        if (is_activation_skill_with_x(modified_s.id) && !modified_s.x)
+    // perform skill (if it is still applicable)
+    if (has_x && !modified_s.x)
+    {
+        _DEBUG_MSG(2, "%s failed to %s because its X value is zeroed (sabotaged).\n",
+                status_description(status).c_str(), skill_description(fd->cards, ss).c_str());
+        return;
+    }
+    perform_activation_skill(fd, status, modified_s);
+}
+//------------------------------------------------------------------------------
+// Activation skill of the acting unit itself (compiled skill program)
+inline void resolve_activation_skill(Field* fd, CardStatus* status, const CompiledSkill& cs)
+{
+    if (!is_alive(status))
+    {
+        _DEBUG_MSG(2, "%s failed to %s because it is dead.\n",
+                status_description(status).c_str(), skill_description(fd->cards, cs.ss).c_str());
+        return;
+    }
+    if (status->m_jammed)
+    {
+        _DEBUG_MSG(2, "%s failed to %s because it is Jammed.\n",
+                status_description(status).c_str(), skill_description(fd->cards, cs.ss).c_str());
+        return;
+    }
+    perform_modified_skill(fd, status, cs.ss, cs.has_x);
+}
+//------------------------------------------------------------------------------
+// One queued (or compiled triggered) skill; has_x: precomputed is_activation_skill_with_x()
+inline void resolve_skill_instance(Field* fd, CardStatus* status, const SkillSpec& ss, bool has_x)
+{
+    if (__builtin_expect(status->m_card->m_skill_trigger[ss.id] == Skill::Trigger::activate, true))
+    {
+        if (!is_alive(status))
         {
-            _DEBUG_MSG(2, "%s failed to %s because its X value is zeroed (sabotaged).\n",
+            _DEBUG_MSG(2, "%s failed to %s because it is dead.\n",
                     status_description(status).c_str(), skill_description(fd->cards, ss).c_str());
-            continue;
+            return;
+        }
+        if (status->m_jammed)
+        {
+            _DEBUG_MSG(2, "%s failed to %s because it is Jammed.\n",
+                    status_description(status).c_str(), skill_description(fd->cards, ss).c_str());
+            return;
         }
-        else { skill_table[modified_s.id](fd, status, modified_s); }
+    }
+
+    // is summon? (non-activation skill)
+    if (ss.id == Skill::summon)
+    {
+        check_and_perform_summon(fd, status);
+        return;
+    }
+    _DEBUG_ASSERT(is_activation_skill(ss.id) || ss.id == Skill::enhance); // enhance is no trigger, but  queues the skill
+
+    perform_modified_skill(fd, status, ss, has_x);
+}
+//------------------------------------------------------------------------------
+void resolve_skill(Field* fd)
+{
+    while (!fd->skill_queue.empty())
+    {
+        auto skill_instance(fd->skill_queue.front());
+        auto& status(std::get<0>(skill_instance));
+        const auto& ss(std::get<1>(skill_instance));
+        fd->skill_queue.pop_front();
+        resolve_skill_instance(fd, status, ss, is_activation_skill_with_x(ss.id));
     }
 }
 
@@ -683,23 +793,23 @@ inline bool check_and_perform_skill(Field* fd, CardStatus* src, CardStatus* dst,
         );
 
     template <enum CardType::CardType type>
-void evaluate_skills(Field* fd, CardStatus* status, const std::vector<SkillSpec>& skills, bool* attacked=nullptr)
+void evaluate_skills(Field* fd, CardStatus* status, bool* attacked=nullptr)
 {
     _DEBUG_ASSERT(status);
+    const Card* card = status->m_card;
     unsigned num_actions(1);
     for (unsigned action_index(0); action_index < num_actions; ++ action_index)
     {
         status->m_action_index = action_index;
         fd->prepare_action();
         _DEBUG_ASSERT(fd->skill_queue.size() == 0);
-        for (auto & ss: skills)
+        for (const auto & cs: card->m_activation_skills)
         {
-            if (!is_activation_skill(ss.id)) { continue; }
-            if (status->m_skill_cd[ss.id] > 0) { continue; }
+            if (status->skill_cd(cs.ss.id) > 0) { continue; }
             _DEBUG_MSG(2, "Evaluating %s skill %s\n",
-                    status_description(status).c_str(), skill_description(fd->cards, ss).c_str());
-            fd->skill_queue.emplace_back(status, ss);
-            resolve_skill(fd);
+                    status_description(status).c_str(), skill_description(fd->cards, cs.ss).c_str());
+            resolve_activation_skill(fd, status, cs);
+            resolve_skill(fd); // skills queued by the one above (e.g. On Death)
         }
         if (type == CardType::assault)
         {
@@ -728,7 +838,7 @@ void evaluate_skills(Field* fd, CardStatus* status, const std::vector<SkillSpec>
         }
         fd->finalize_action();
         // Flurry
-        if (can_act(status) && status->has_skill(Skill::flurry) && (status->m_skill_cd[Skill::flurry] == 0))
+        if (can_act(status) && status->has_skill(Skill::flurry) && (status->skill_cd(Skill::flurry) == 0))
         {
 #ifndef NQUEST
             if (status->m_player == 0)
@@ -739,12 +849,12 @@ void evaluate_skills(Field* fd, CardStatus* status, const std::vector<SkillSpec>
             _DEBUG_MSG(1, "%s activates Flurry x %d\n",
                     status_description(status).c_str(), status->skill_base_value(Skill::flurry));
             num_actions += status->skill_base_value(Skill::flurry);
-            for (const auto & ss : skills)
+            for (const auto & ss : card->m_skills)
             {
-                Skill::Skill evolved_skill_id = static_cast<Skill::Skill>(ss.id + status->m_evolved_skill_offset[ss.id]);
+                Skill::Skill evolved_skill_id = static_cast<Skill::Skill>(ss.id + status->evolved_skill_offset(ss.id));
                 if (evolved_skill_id == Skill::flurry)
                 {
-                    status->m_skill_cd[ss.id] = ss.c;
+                    status->skill_state(ss.id).m_cd = ss.c;
                 }
             }
         }
@@ -803,7 +913,7 @@ struct PlayCard
 
             // 1. Evaluate skill Allegiance & count assaults with same faction (structures will be counted later)
             // 2. Passive BGE Cold Sleep
-            for (CardStatus* status_i : fd->tap->assaults.m_indirect)
+            for (CardStatus* status_i : fd->tap->assaults)
             {
                 if (status_i == status || !is_alive(status_i)) { continue; } // except itself
                 //std::cout << status_description(status_i).c_str();
@@ -848,7 +958,7 @@ struct PlayCard
                     && ((allegiance_value = status->skill(Skill::allegiance)) > 0))
             {
                 // count structures with same faction (except fortresses, dominions and other non-normal structures)
-                for (CardStatus * status_i : fd->tap->structures.m_indirect)
+                for (CardStatus * status_i : fd->tap->structures)
                 {
                     if ((status_i->m_card->m_category == CardCategory::normal)
                             && (bge_megamorphosis || (status_i->m_card->m_faction == card->m_faction)))
@@ -885,7 +995,7 @@ struct PlayCard
                             status_description(&fd->tap->commander).c_str(), stacked_stasis);
                 }
 #endif
-                for (CardStatus * status_i : fd->tap->structures.m_indirect)
+                for (CardStatus * status_i : fd->tap->structures)
                 {
                     if ((bge_megamorphosis || (status_i->m_card->m_faction == card->m_faction)) && is_alive(status_i))
                     {
@@ -900,7 +1010,7 @@ struct PlayCard
 #endif
                     }
                 }
-                for (CardStatus * status_i : fd->tap->assaults.m_indirect)
+                for (CardStatus * status_i : fd->tap->assaults)
                 {
                     if ((bge_megamorphosis || (status_i->m_card->m_faction == card->m_faction)) && is_alive(status_i))
                     {
@@ -951,14 +1061,16 @@ struct PlayCard
 
 
             // resolve On-Play skills
+            if (card->m_on_play_skills.empty())
+            { return status; }
             // Fix Death on BGE: [On Play] skills during BGE phase can be invoked only by means of [On Death] trigger
             if (__builtin_expect(fd->fixes[Fix::death_from_bge] && (fd->current_phase != Field::bge_phase), true))
             {
-                for (const auto& ss: card->m_skills_on_play)
+                for (const auto& cs: card->m_on_play_skills)
                 {
                     _DEBUG_MSG(2, "On Play %s: Preparing (tail) skill %s\n",
-                            status_description(status).c_str(), skill_description(fd->cards, ss).c_str());
-                    fd->skill_queue.emplace_back(status, ss);
+                            status_description(status).c_str(), skill_description(fd->cards, cs.ss).c_str());
+                    fd->skill_queue.emplace_back(status, cs.ss);
                 }
             }
             else
@@ -1226,11 +1338,12 @@ void cooldown_skills(CardStatus * status)
 {
     for (const auto & ss : status->m_card->m_skills)
     {
-        if (status->m_skill_cd[ss.id] > 0)
+        CardSkillState& state = status->skill_state(ss.id);
+        if (state.m_cd > 0)
         {
             _DEBUG_MSG(2, "%s reduces timer (%u) of skill %s\n",
-                    status_description(status).c_str(), status->m_skill_cd[ss.id], skill_names[ss.id].c_str());
-            -- status->m_skill_cd[ss.id];
+                    status_description(status).c_str(), state.m_cd, skill_names[ss.id].c_str());
+            -- state.m_cd;
         }
     }
 }
@@ -1336,9 +1449,7 @@ void turn_end_phase(Field* fd)
             }
             status.m_enfeebled = 0;
             status.m_protected = 0;
-            std::memset(status.m_primary_skill_offset, 0, sizeof status.m_primary_skill_offset);
-            std::memset(status.m_evolved_skill_offset, 0, sizeof status.m_evolved_skill_offset);
-            std::memset(status.m_enhanced_value, 0, sizeof status.m_enhanced_value);
+            status.reset_skill_modifiers();
             status.m_evaded = 0;  // so far only useful in Inactive turn
             status.m_paybacked = 0;  // ditto
             status.m_entrapped = 0;
@@ -1709,7 +1820,7 @@ struct PerformAttack
                 if (__builtin_expect(coalition_base, false))
                 {
                     uint8_t factions_bitmap = 0;
-                    for (CardStatus * status : att_assaults.m_indirect)
+                    for (CardStatus * status : att_assaults)
                     {
                         if (! is_alive(status)) { continue; }
                         factions_bitmap |= (1 << (status->m_card->m_faction));
@@ -1855,11 +1966,14 @@ struct PerformAttack
         void on_attacked() {
             //APN
             // resolve On-Attacked skills
-            for (const auto& ss: def_status->m_card->m_skills_on_attacked)
+            for (const auto& cs: def_status->m_card->m_on_attacked_skills)
             {
                 _DEBUG_MSG(1, "On Attacked %s: Preparing (tail) skill %s\n",
-                        status_description(def_status).c_str(), skill_description(fd->cards, ss).c_str());
-                fd->skill_queue.emplace_back(def_status, ss);
+                        status_description(def_status).c_str(), skill_description(fd->cards, cs.ss).c_str());
+                if (fd->skill_queue.empty())
+                { resolve_skill_instance(fd, def_status, cs.ss, cs.has_x); } // nothing queued before it: no round-trip
+                else
+                { fd->skill_queue.emplace_back(def_status, cs.ss); }
                 resolve_skill(fd);
             }
         }
@@ -2119,14 +2233,12 @@ inline bool skill_predicate<Skill::mimic>(Field* fd, CardStatus* src, CardStatus
     //include on activate/attacked/death
     //for(const auto & a  : {dst->m_card->m_skills,dst->m_card->m_skills_on_play,dst->m_card->m_skills_on_death,dst->m_card->m_skills_on_attacked})
     //
-    std::vector<std::vector<SkillSpec>> all;
-    all.emplace_back(dst->m_card->m_skills);
-    all.emplace_back(dst->m_card->m_skills_on_attacked);
+    const std::vector<SkillSpec>* all[] = {&dst->m_card->m_skills, &dst->m_card->m_skills_on_attacked};
 
-    for(std::vector<SkillSpec> & a  : all)
+    for(const std::vector<SkillSpec>* a : all)
     {
     // scan all enemy skills until first activation
-    for (const SkillSpec & ss: a)
+    for (const SkillSpec & ss: *a)
     {
         // get skill
         Skill::Skill skill_id = static_cast<Skill::Skill>(ss.id);
@@ -2160,11 +2272,11 @@ inline bool skill_predicate<Skill::overload>(Field* fd, CardStatus* src, CardSta
     for (const auto& ss: dst->m_card->m_skills)
     {
         // skip cooldown skills
-        if (dst->m_skill_cd[ss.id] > 0)
+        if (dst->skill_cd(ss.id) > 0)
         { continue; }
 
         // get evolved skill
-        Skill::Skill evolved_skill_id = static_cast<Skill::Skill>(ss.id + dst->m_evolved_skill_offset[ss.id]);
+        Skill::Skill evolved_skill_id = static_cast<Skill::Skill>(ss.id + dst->evolved_skill_offset(ss.id));
 
         // unit with an activation hostile skill is always valid target for OL
         if (is_activation_hostile_skill(evolved_skill_id))
@@ -2176,7 +2288,7 @@ inline bool skill_predicate<Skill::overload>(Field* fd, CardStatus* src, CardSta
                 && is_activation_helpful_skill(evolved_skill_id)
                 && __builtin_expect(!inhibited_searched, true))
         {
-            for (const auto & c: fd->players[dst->m_player]->assaults.m_indirect)
+            for (const auto & c: fd->players[dst->m_player]->assaults)
             {
                 if (is_alive(c) && c->m_inhibited)
                 { return true; }
@@ -2251,18 +2363,20 @@ inline void perform_skill<Skill::enfeeble>(Field* fd, CardStatus* src, CardStatu
     template<>
 inline void perform_skill<Skill::enhance>(Field* fd, CardStatus* src, CardStatus* dst, const SkillSpec& s)
 {
-    dst->m_enhanced_value[s.s + dst->m_primary_skill_offset[s.s]] += s.x;
+    dst->skill_state(static_cast<Skill::Skill>(s.s + dst->primary_skill_offset(s.s))).m_enhanced_value += s.x;
+    dst->m_enhanced = true;
 }
 
     template<>
 inline void perform_skill<Skill::evolve>(Field* fd, CardStatus* src, CardStatus* dst, const SkillSpec& s)
 {
-    auto primary_s1 = dst->m_primary_skill_offset[s.s] + s.s;
-    auto primary_s2 = dst->m_primary_skill_offset[s.s2] + s.s2;
-    dst->m_primary_skill_offset[s.s] = primary_s2 - s.s;
-    dst->m_primary_skill_offset[s.s2] = primary_s1 - s.s2;
-    dst->m_evolved_skill_offset[primary_s1] = s.s2 - primary_s1;
-    dst->m_evolved_skill_offset[primary_s2] = s.s - primary_s2;
+    auto primary_s1 = static_cast<Skill::Skill>(dst->primary_skill_offset(s.s) + s.s);
+    auto primary_s2 = static_cast<Skill::Skill>(dst->primary_skill_offset(s.s2) + s.s2);
+    dst->skill_state(s.s).m_primary_offset = primary_s2 - s.s;
+    dst->skill_state(s.s2).m_primary_offset = primary_s1 - s.s2;
+    dst->skill_state(primary_s1).m_evolved_offset = s.s2 - primary_s1;
+    dst->skill_state(primary_s2).m_evolved_offset = s.s - primary_s2;
+    dst->m_evolved = true;
 }
 
     template<>
@@ -2397,16 +2511,13 @@ inline void perform_skill<Skill::sunder>(Field* fd, CardStatus* src, CardStatus*
 inline void perform_skill<Skill::mimic>(Field* fd, CardStatus* src, CardStatus* dst, const SkillSpec& s)
 {
     // collect all mimickable enemy skills
-    std::vector<const SkillSpec *> mimickable_skills;
-    mimickable_skills.reserve(dst->m_card->m_skills.size()+dst->m_card->m_skills_on_play.size()+dst->m_card->m_skills_on_death.size()+dst->m_card->m_skills_on_attacked.size());
+    InlineVector<const SkillSpec *, Skill::num_skills> mimickable_skills;  // a card has each skill at most once
     _DEBUG_MSG(2, " * Mimickable skills of %s\n", status_description(dst).c_str());
     //include on activate/attacked
-    std::vector<std::vector<SkillSpec>> all;
-    all.emplace_back(dst->m_card->m_skills);
-    all.emplace_back(dst->m_card->m_skills_on_attacked);
-    for(std::vector<SkillSpec> & a : all)
+    const std::vector<SkillSpec>* all[] = {&dst->m_card->m_skills, &dst->m_card->m_skills_on_attacked};
+    for(const std::vector<SkillSpec>* a : all)
     {
-    for (const SkillSpec & ss: a)
+    for (const SkillSpec & ss: *a)
     {
         // get skill
         Skill::Skill skill_id = static_cast<Skill::Skill>(ss.id);
@@ -2419,7 +2530,7 @@ inline void perform_skill<Skill::mimic>(Field* fd, CardStatus* src, CardStatus*
         if ((skill_id == Skill::mend || skill_id == Skill::fortify) && (src->m_card->m_type != CardType::assault))
         { continue; }
 
-        mimickable_skills.emplace_back(&ss);
+        mimickable_skills.push_back(&ss);
         _DEBUG_MSG(2, "  + %s\n", skill_description(fd->cards, ss).c_str());
     }
     }
@@ -2430,7 +2541,7 @@ inline void perform_skill<Skill::mimic>(Field* fd, CardStatus* src, CardStatus*
     {
         case 0: assert(false); break;
         case 1: break;
-        default: mim_idx = (fd->re() % mimickable_skills.size()); break;
+        default: mim_idx = fd->re.bounded(mimickable_skills.size()); break;
     }
     // prepare & perform selected skill
     const SkillSpec & mim_ss = *mimickable_skills[mim_idx];
@@ -2442,7 +2553,7 @@ inline void perform_skill<Skill::mimic>(Field* fd, CardStatus* src, CardStatus*
 }
 
     template<unsigned skill_id>
-inline unsigned select_fast(Field* fd, CardStatus* src, const std::vector<CardStatus*>& cards, const SkillSpec& s)
+inline unsigned select_fast(Field* fd, CardStatus* src, Storage<CardStatus>& cards, const SkillSpec& s)
 {
     if ((s.y == allfactions)
             || fd->bg_effects[fd->tapi][PassiveBGE::metamorphosis]
@@ -2463,7 +2574,7 @@ inline unsigned select_fast(Field* fd, CardStatus* src, const std::vector<CardSt
 }
 
     template<>
-inline unsigned select_fast<Skill::mend>(Field* fd, CardStatus* src, const std::vector<CardStatus*>& cards, const SkillSpec& s)
+inline unsigned select_fast<Skill::mend>(Field* fd, CardStatus* src, Storage<CardStatus>& cards, const SkillSpec& s)
 {
     fd->selection_array.clear();
     bool critical_reach = fd->bg_effects[fd->tapi][PassiveBGE::criticalreach];
@@ -2486,7 +2597,7 @@ inline unsigned select_fast<Skill::mend>(Field* fd, CardStatus* src, const std::
 }
 
     template<>
-inline unsigned select_fast<Skill::fortify>(Field* fd, CardStatus* src, const std::vector<CardStatus*>& cards, const SkillSpec& s)
+inline unsigned select_fast<Skill::fortify>(Field* fd, CardStatus* src, Storage<CardStatus>& cards, const SkillSpec& s)
 {
     fd->selection_array.clear();
     bool critical_reach = fd->bg_effects[fd->tapi][PassiveBGE::criticalreach];
@@ -2507,85 +2618,85 @@ inline unsigned select_fast<Skill::fortify>(Field* fd, CardStatus* src, const st
     }
     return fd->selection_array.size();
 }
-inline std::vector<CardStatus*>& skill_targets_hostile_assault(Field* fd, CardStatus* src)
+inline Storage<CardStatus>& skill_targets_hostile_assault(Field* fd, CardStatus* src)
 {
-    return(fd->players[opponent(src->m_player)]->assaults.m_indirect);
+    return(fd->players[opponent(src->m_player)]->assaults);
 }
 
-inline std::vector<CardStatus*>& skill_targets_allied_assault(Field* fd, CardStatus* src)
+inline Storage<CardStatus>& skill_targets_allied_assault(Field* fd, CardStatus* src)
 {
-    return(fd->players[src->m_player]->assaults.m_indirect);
+    return(fd->players[src->m_player]->assaults);
 }
 
-inline std::vector<CardStatus*>& skill_targets_hostile_structure(Field* fd, CardStatus* src)
+inline Storage<CardStatus>& skill_targets_hostile_structure(Field* fd, CardStatus* src)
 {
-    return(fd->players[opponent(src->m_player)]->structures.m_indirect);
+    return(fd->players[opponent(src->m_player)]->structures);
 }
 
-inline std::vector<CardStatus*>& skill_targets_allied_structure(Field* fd, CardStatus* src)
+inline Storage<CardStatus>& skill_targets_allied_structure(Field* fd, CardStatus* src)
 {
-    return(fd->players[src->m_player]->structures.m_indirect);
+    return(fd->players[src->m_player]->structures);
 }
 
     template<unsigned skill>
-std::vector<CardStatus*>& skill_targets(Field* fd, CardStatus* src)
+Storage<CardStatus>& skill_targets(Field* fd, CardStatus* src)
 {
     std::cerr << "skill_targets: Error: no specialization for " << skill_names[skill] << "\n";
     throw;
 }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::enfeeble>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::enfeeble>(Field* fd, CardStatus* src)
 { return(skill_targets_hostile_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::enhance>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::enhance>(Field* fd, CardStatus* src)
 { return(skill_targets_allied_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::evolve>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::evolve>(Field* fd, CardStatus* src)
 { return(skill_targets_allied_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::heal>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::heal>(Field* fd, CardStatus* src)
 { return(skill_targets_allied_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::jam>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::jam>(Field* fd, CardStatus* src)
 { return(skill_targets_hostile_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::mend>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::mend>(Field* fd, CardStatus* src)
 { return(skill_targets_allied_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::fortify>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::fortify>(Field* fd, CardStatus* src)
 { return(skill_targets_allied_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::overload>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::overload>(Field* fd, CardStatus* src)
 { return(skill_targets_allied_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::protect>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::protect>(Field* fd, CardStatus* src)
 { return(skill_targets_allied_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::rally>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::rally>(Field* fd, CardStatus* src)
 { return(skill_targets_allied_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::enrage>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::enrage>(Field* fd, CardStatus* src)
 { return(skill_targets_allied_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::entrap>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::entrap>(Field* fd, CardStatus* src)
 { return(skill_targets_allied_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::rush>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::rush>(Field* fd, CardStatus* src)
 { return(skill_targets_allied_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::siege>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::siege>(Field* fd, CardStatus* src)
 { return(skill_targets_hostile_structure(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::strike>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::strike>(Field* fd, CardStatus* src)
 { return(skill_targets_hostile_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::sunder>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::sunder>(Field* fd, CardStatus* src)
 { return(skill_targets_hostile_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::weaken>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::weaken>(Field* fd, CardStatus* src)
 { return(skill_targets_hostile_assault(fd, src)); }
 
-template<> std::vector<CardStatus*>& skill_targets<Skill::mimic>(Field* fd, CardStatus* src)
+template<> Storage<CardStatus>& skill_targets<Skill::mimic>(Field* fd, CardStatus* src)
 { return(skill_targets_hostile_assault(fd, src)); }
 
     template<Skill::Skill skill_id>
@@ -2618,7 +2729,7 @@ inline bool check_and_perform_skill(Field* fd, CardStatus* src, CardStatus* dst,
         perform_skill<skill_id>(fd, src, dst, s);
         if (s.c > 0)
         {
-            src->m_skill_cd[skill_id] = s.c;
+            src->skill_state(skill_id).m_cd = s.c;
         }
         // Skill: Tribute
         if (skill_check<Skill::tribute>(fd, dst, src)
@@ -2950,7 +3061,7 @@ void perform_targetted_allied_fast_rush(Field* fd, CardStatus* src, const SkillS
 void perform_targetted_hostile_fast(Field* fd, CardStatus* src, const SkillSpec& s)
 {
     select_targets<skill_id>(fd, src, s);
-    std::vector<CardStatus *> paybackers;
+    InlineVector<CardStatus *, Field::max_field_units> paybackers;
 #ifndef NQUEST
     bool has_counted_quest = false;
 #endif
@@ -2986,7 +3097,6 @@ void perform_targetted_hostile_fast(Field* fd, CardStatus* src, const SkillSpec&
             unsigned payback_value = dst->skill(Skill::payback) + dst->skill(Skill::revenge);
             if ((s.id != Skill::mimic) && (dst->m_paybacked < payback_value) && skill_check<Skill::payback>(fd, dst, src))
             {
-                paybackers.reserve(selection_array_len);
                 paybackers.push_back(dst);
             }
         }
@@ -3329,9 +3439,9 @@ Results<uint64_t> evaluate_sim_result(Field* fd, bool single_turn_both)
         case OptimizationMode::quest:
             if (fd->quest.quest_type == QuestType::card_survival)
             {
-                for (const auto & status: p[0]->assaults.m_indirect)
+                for (const auto & status: p[0]->assaults)
                 { fd->quest_counter += (fd->quest.quest_key == status->m_card->m_id); }
-                for (const auto & status: p[0]->structures.m_indirect)
+                for (const auto & status: p[0]->structures)
                 { fd->quest_counter += (fd->quest.quest_key == status->m_card->m_id); }
                 for (const auto & card: p[0]->deck->shuffled_cards)
                 { fd->quest_counter += (fd->quest.quest_key == card->m_id); }
@@ -3575,7 +3685,7 @@ Results<uint64_t> play(Field* fd,bool skip_init, bool skip_preplay,unsigned turn
         // Evaluate Passive BGE Heroism skills
         if (__builtin_expect(fd->bg_effects[fd->tapi][PassiveBGE::heroism], false))
         {
-            for (CardStatus * dst: fd->tap->assaults.m_indirect)
+            for (CardStatus * dst: fd->tap->assaults)
             {
                 unsigned bge_value = (dst->skill(Skill::valor) + dst->skill(Skill::bravery)+ 1) / 2;
                 if (bge_value <= 0)
@@ -3642,7 +3752,7 @@ Results<uint64_t> play(Field* fd,bool skip_init, bool skip_preplay,unsigned turn
 
         // Evaluate commander
         fd->current_phase = Field::commander_phase;
-        evaluate_skills<CardType::commander>(fd, &fd->tap->commander, fd->tap->commander.m_card->m_skills);
+        evaluate_skills<CardType::commander>(fd, &fd->tap->commander);
         if (__builtin_expect(fd->end, false)) { break; }
 
         // Evaluate structures
@@ -3656,7 +3766,7 @@ Results<uint64_t> play(Field* fd,bool skip_init, bool skip_preplay,unsigned turn
             }
             else
             {
-                evaluate_skills<CardType::structure>(fd, current_status, current_status->m_card->m_skills);
+                evaluate_skills<CardType::structure>(fd, current_status);
             }
         }
 
@@ -3698,7 +3808,7 @@ Results<uint64_t> play(Field* fd,bool skip_init, bool skip_preplay,unsigned turn
                 current_status->m_protected_stasis = 0;
                 fd->assault_bloodlusted = false;
                 current_status->m_step = CardStep::attacking;
-                evaluate_skills<CardType::assault>(fd, current_status, current_status->m_card->m_skills, &attacked);
+                evaluate_skills<CardType::assault>(fd, current_status, &attacked);
                 if (__builtin_expect(fd->end, false)) { break; }
                 if (__builtin_expect(!is_alive(current_status), false)) { continue; }
             }
@@ -3717,27 +3827,47 @@ Results<uint64_t> play(Field* fd,bool skip_init, bool skip_preplay,unsigned turn
     return evaluate_sim_result(fd,turns_both!= 0);
 }
 
+//------------------------------------------------------------------------------
+// The activation skills and their performers: skill_table (fill_skill_table()) and the
+// direct dispatch (perform_activation_skill()) are both generated from this list
+#define ACTIVATION_SKILLS(X) \
+    X(mortar, perform_targetted_hostile_fast<Skill::mortar>) \
+    X(enfeeble, perform_targetted_hostile_fast<Skill::enfeeble>) \
+    X(enhance, perform_targetted_allied_fast<Skill::enhance>) \
+    X(evolve, perform_targetted_allied_fast<Skill::evolve>) \
+    X(heal, perform_targetted_allied_fast<Skill::heal>) \
+    X(jam, perform_targetted_hostile_fast<Skill::jam>) \
+    X(mend, perform_targetted_allied_fast<Skill::mend>) \
+    X(fortify, perform_targetted_allied_fast<Skill::fortify>) \
+    X(overload, perform_targetted_allied_fast<Skill::overload>) \
+    X(protect, perform_targetted_allied_fast<Skill::protect>) \
+    X(rally, perform_targetted_allied_fast<Skill::rally>) \
+    X(enrage, perform_targetted_allied_fast<Skill::enrage>) \
+    X(entrap, perform_targetted_allied_fast<Skill::entrap>) \
+    X(rush, perform_targetted_allied_fast_rush) \
+    X(siege, perform_targetted_hostile_fast<Skill::siege>) \
+    X(strike, perform_targetted_hostile_fast<Skill::strike>) \
+    X(sunder, perform_targetted_hostile_fast<Skill::sunder>) \
+    X(weaken, perform_targetted_hostile_fast<Skill::weaken>) \
+    X(mimic, perform_targetted_hostile_fast<Skill::mimic>)
+
+// Direct dispatch of activation skills (lets the compiler inline the performers)
+inline void perform_activation_skill(Field* fd, CardStatus* src, const SkillSpec& s)
+{
+#define ACTIVATION_SKILL_CASE(skill, performer) case Skill::skill: performer(fd, src, s); break;
+    switch (s.id)
+    {
+    ACTIVATION_SKILLS(ACTIVATION_SKILL_CASE)
+    default: skill_table[s.id](fd, src, s); break;
+    }
+#undef ACTIVATION_SKILL_CASE
+}
 //------------------------------------------------------------------------------
 void fill_skill_table()
 {
     memset(skill_table, 0, sizeof skill_table);
-    skill_table[Skill::mortar] = perform_targetted_hostile_fast<Skill::mortar>;
-    skill_table[Skill::enfeeble] = perform_targetted_hostile_fast<Skill::enfeeble>;
-    skill_table[Skill::enhance] = perform_targetted_allied_fast<Skill::enhance>;
-    skill_table[Skill::evolve] = perform_targetted_allied_fast<Skill::evolve>;
-    skill_table[Skill::heal] = perform_targetted_allied_fast<Skill::heal>;
-    skill_table[Skill::jam] = perform_targetted_hostile_fast<Skill::jam>;
-    skill_table[Skill::mend] = perform_targetted_allied_fast<Skill::mend>;
-    skill_table[Skill::fortify] = perform_targetted_allied_fast<Skill::fortify>;
-    skill_table[Skill::overload] = perform_targetted_allied_fast<Skill::overload>;
-    skill_table[Skill::protect] = perform_targetted_allied_fast<Skill::protect>;
-    skill_table[Skill::rally] = perform_targetted_allied_fast<Skill::rally>;
-    skill_table[Skill::enrage] = perform_targetted_allied_fast<Skill::enrage>;
-    skill_table[Skill::entrap] = perform_targetted_allied_fast<Skill::entrap>;
-    skill_table[Skill::rush] = perform_targetted_allied_fast_rush;
-    skill_table[Skill::siege] = perform_targetted_hostile_fast<Skill::siege>;
-    skill_table[Skill::strike] = perform_targetted_hostile_fast<Skill::strike>;
-    skill_table[Skill::sunder] = perform_targetted_hostile_fast<Skill::sunder>;
-    skill_table[Skill::weaken] = perform_targetted_hostile_fast<Skill::weaken>;
-    skill_table[Skill::mimic] = perform_targetted_hostile_fast<Skill::mimic>;
+#define ACTIVATION_SKILL_ENTRY(skill, performer) skill_table[Skill::skill] = performer;
+    ACTIVATION_SKILLS(ACTIVATION_SKILL_ENTRY)
+#undef ACTIVATION_SKILL_ENTRY
 }
+#undef ACTIVATION_SKILLS
@@ -1,7 +1,8 @@
 #ifndef SIM_H_INCLUDED
 #define SIM_H_INCLUDED
 
-#include <boost/pool/pool.hpp>
+#include <cstring>
+#include <stdexcept>
 #include <string>
 #include <array>
 #include <deque>
@@ -12,10 +13,12 @@
 #include <random>
 
 #include "tyrant.h"
+#include "rng.h"
 
 class Card;
 class Cards;
 class Deck;
+class DecisionCache;
 class Field;
 class Achievement;
 
@@ -66,40 +69,62 @@ bool operator <(const FinalResults<result_type>& x, const FinalResults<result_ty
 
 void fill_skill_table();
 Results<uint64_t> play(Field* fd, bool skip_init=false, bool skip_preplay=false , unsigned turns_both=0);
-// Pool-based indexed storage.
-//---------------------- Pool-based indexed storage ----------------------------
-template<typename T>
+//---------------------- Inline indexed storage --------------------------------
+// Items live contiguously in a fixed-size inline buffer (no allocation at all),
+// so a copy of the storage is a single memcpy of the live prefix.
+// Iterating yields pointers to the items (as callers expect CardStatus*).
+// Pointers stay valid until remove() compacts the buffer (end of turn).
+enum { max_storage_slots = 32 };  // max units of one kind on board (incl. summons and dead not yet removed)
+
+template<typename T, unsigned capacity = max_storage_slots>
 class Storage
 {
 public:
-    typedef typename std::vector<T*>::size_type size_type;
+    typedef unsigned size_type;
     typedef T value_type;
-    Storage(size_type size) :
-        m_pool(sizeof(T))
+
+    class iterator
+    {
+    public:
+        iterator(T* ptr) : m_ptr(ptr) {}
+        inline T* operator*() const { return m_ptr; }
+        inline iterator& operator++() { ++ m_ptr; return *this; }
+        inline bool operator==(const iterator& other) const { return m_ptr == other.m_ptr; }
+        inline bool operator!=(const iterator& other) const { return m_ptr != other.m_ptr; }
+    private:
+        T* m_ptr;
+    };
+
+    Storage() :
+        m_size(0)
     {
-        m_indirect.reserve(size);
     }
 
     Storage(const Storage &s) :
-	m_pool(sizeof(T))
+        m_size(s.m_size)
     {
-	m_indirect.reserve(s.m_indirect.capacity());
-	for(T* t : s.m_indirect)
-	{
-	     T* c = &add_back();
-	     *c=*t;
-	}
+        std::memcpy(static_cast<void*>(m_items), s.m_items, m_size * sizeof(T));
+    }
+
+    Storage& operator=(const Storage &s)
+    {
+        m_size = s.m_size;
+        std::memcpy(static_cast<void*>(m_items), s.m_items, m_size * sizeof(T));
+        return *this;
     }
 
     inline T& operator[](size_type i)
     {
-        return(*m_indirect[i]);
+        return(m_items[i]);
     }
 
     inline T& add_back()
     {
-        m_indirect.emplace_back((T*) m_pool.malloc());
-        return(*m_indirect.back());
+        if (__builtin_expect(m_size >= capacity, false))
+        {
+            throw std::runtime_error("Storage: too many units on board (max " + to_string(capacity) + ")");
+        }
+        return(m_items[m_size ++]);
     }
 
     template<typename Pred>
@@ -109,61 +134,179 @@ public:
          *  [a-z]       -   predicate unmatched cards (alive)
          *  [X]         -   predicate matched cards (dead)
          *
-         *  m_indirect:     [a][X][b][X][X][c]
+         *  m_items:        [a][X][b][X][X][c]
          *                   ^ head
          *                   ^ current
          *
-         *                   ... (loop logic: shift unmatched cards to left) ...
+         *                   ... (loop logic: shift unmatched cards to left, keeping their order) ...
          *
          *                  [a][b][c][X][X][c]
-         *                           |-------> erase
-         *                           (allocated memory has been freed for matched cards)
+         *                           |-------> dropped
          *
          *                            ^ head
          *                                     ^ current
-         *  new m_indirect: [a][b][c]
+         *  new m_items:    [a][b][c]
          */
         size_type head(0);
-        for(size_type current(0); current < m_indirect.size(); ++current)
+        for(size_type current(0); current < m_size; ++current)
         {
-            if(p((*this)[current]))
-            {
-                m_pool.free(m_indirect[current]);
-            }
-            else
+            if(!p(m_items[current]))
             {
                 if(current != head)
                 {
-                    m_indirect[head] = m_indirect[current];
+                    std::memcpy(static_cast<void*>(&m_items[head]), &m_items[current], sizeof(T));
                 }
                 ++head;
             }
         }
-        m_indirect.erase(m_indirect.begin() + head, m_indirect.end());
+        m_size = head;
     }
 
     template<typename Pred>
     unsigned count(Pred p)
     {
-        return std::count_if(m_indirect.begin(), m_indirect.end(), p);
+        unsigned n(0);
+        for(size_type i(0); i < m_size; ++i)
+        {
+            n += p(&m_items[i]) ? 1 : 0;
+        }
+        return n;
     }
 
     void reset()
     {
-        for(auto index: m_indirect)
+        m_size = 0;
+    }
+
+    inline size_type size() const
+    {
+        return(m_size);
+    }
+
+    inline iterator begin() { return iterator(m_items); }
+    inline iterator end() { return iterator(m_items + m_size); }
+
+private:
+    size_type m_size;
+    T m_items[capacity];
+};
+
+//---------------------- Inline per-action lists -------------------------------
+// Fixed-capacity vector/queue/counter for the scratch lists of Field, sized for
+// a battle: they never allocate, so a warm play() does no heap allocation.
+template<typename T, unsigned capacity>
+class InlineVector
+{
+public:
+    typedef unsigned size_type;
+    typedef T value_type;
+
+    InlineVector() :
+        m_size(0)
+    {
+    }
+
+    inline T& operator[](size_type i) { return(m_items[i]); }
+    inline const T& operator[](size_type i) const { return(m_items[i]); }
+
+    inline void push_back(const T& item)
+    {
+        if (__builtin_expect(m_size >= capacity, false))
         {
-            m_pool.free(index);
+            throw std::runtime_error("InlineVector: capacity exceeded (max " + to_string(capacity) + ")");
         }
-        m_indirect.clear();
+        m_items[m_size ++] = item;
     }
 
-    inline size_type size() const
+    inline void resize(size_type size) { _DEBUG_ASSERT(size <= m_size); m_size = size; }  // shrink only
+    inline void clear() { m_size = 0; }
+    inline size_type size() const { return(m_size); }
+    inline bool empty() const { return(m_size == 0); }
+
+    inline T* begin() { return(m_items); }
+    inline T* end() { return(m_items + m_size); }
+    inline const T* begin() const { return(m_items); }
+    inline const T* end() const { return(m_items + m_size); }
+
+private:
+    size_type m_size;
+    T m_items[capacity];
+};
+
+// Ring buffer; capacity must be a power of two
+template<typename T, unsigned capacity>
+class InlineQueue
+{
+    static_assert((capacity & (capacity - 1)) == 0, "InlineQueue: capacity must be a power of two");
+public:
+    typedef unsigned size_type;
+    typedef T value_type;
+
+    InlineQueue() :
+        m_head(0),
+        m_size(0)
     {
-        return(m_indirect.size());
     }
 
-    std::vector<T*> m_indirect;
-    boost::pool<> m_pool;
+    template<typename... Args>
+    inline void emplace_back(Args&&... args)
+    {
+        check_full();
+        m_items[(m_head + m_size ++) & (capacity - 1)] = T(std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    inline void emplace_front(Args&&... args)
+    {
+        check_full();
+        m_head = (m_head - 1) & (capacity - 1);
+        ++ m_size;
+        m_items[m_head] = T(std::forward<Args>(args)...);
+    }
+
+    inline T& front() { return(m_items[m_head]); }
+    inline void pop_front() { m_head = (m_head + 1) & (capacity - 1); -- m_size; }
+    inline void clear() { m_head = 0; m_size = 0; }
+    inline size_type size() const { return(m_size); }
+    inline bool empty() const { return(m_size == 0); }
+
+private:
+    inline void check_full() const
+    {
+        if (__builtin_expect(m_size >= capacity, false))
+        {
+            throw std::runtime_error("InlineQueue: capacity exceeded (max " + to_string(capacity) + ")");
+        }
+    }
+
+    size_type m_head;
+    size_type m_size;
+    T m_items[capacity];
+};
+
+// Small flat map key -> count (linear search; keys are few per action)
+template<typename K, unsigned capacity>
+class InlineCounter
+{
+public:
+    typedef std::pair<K, unsigned> value_type;
+
+    inline unsigned& operator[](const K& key)
+    {
+        for (auto& item: m_items)
+        {
+            if (item.first == key) { return(item.second); }
+        }
+        m_items.push_back(value_type(key, 0));
+        return(m_items[m_items.size() - 1].second);
+    }
+
+    inline void clear() { m_items.clear(); }
+    inline value_type* begin() { return(m_items.begin()); }
+    inline value_type* end() { return(m_items.end()); }
+
+private:
+    InlineVector<value_type, capacity> m_items;
 };
 //------------------------------------------------------------------------------
 enum class CardStep
@@ -173,8 +316,23 @@ enum class CardStep
     attacked,
 };
 //------------------------------------------------------------------------------
+// Per-skill dynamic state of a unit (evolve/enhance offsets and cooldown).
+// Only skills of the card itself (and skills touched by Evolve) get a slot,
+// so a unit no longer carries four full [Skill::num_skills] arrays.
+struct CardSkillState
+{
+    unsigned m_enhanced_value;
+    unsigned short m_cd;
+    unsigned char m_id;
+    signed char m_primary_offset;   // queried skill -> original card skill
+    signed char m_evolved_offset;   // original card skill -> evolved skill
+};
+//------------------------------------------------------------------------------
 struct CardStatus
 {
+    enum { max_skill_states = 16 };
+
+    // hot part: touched on every action
     const Card* m_card;
     unsigned m_index;
     unsigned m_action_index;
@@ -204,16 +362,18 @@ struct CardStatus
     unsigned m_marked;
     unsigned m_diseased;
 
-    signed m_primary_skill_offset[Skill::num_skills];
-    signed m_evolved_skill_offset[Skill::num_skills];
-    unsigned m_enhanced_value[Skill::num_skills];
-    unsigned m_skill_cd[Skill::num_skills];
-
     bool m_jammed;
     bool m_overloaded;
     bool m_rush_attempted;
     bool m_sundered;
     bool m_summoned;
+    bool m_evolved;     // some skill state has evolve offsets
+    bool m_enhanced;    // some skill state has an enhanced value
+
+    // sparse per-skill state: slots [0, m_num_skill_states) are valid,
+    // prefilled from the card skills by set()
+    unsigned m_num_skill_states;
+    CardSkillState m_skill_states[max_skill_states];
 
     CardStatus() {}
 
@@ -230,6 +390,14 @@ struct CardStatus
     inline unsigned max_hp() const;
     inline unsigned add_hp(unsigned value);
     inline unsigned ext_hp(unsigned value);
+
+    inline const CardSkillState* find_skill_state(Skill::Skill skill_id) const;
+    inline CardSkillState& skill_state(Skill::Skill skill_id);
+    inline signed primary_skill_offset(Skill::Skill skill_id) const;
+    inline signed evolved_skill_offset(Skill::Skill skill_id) const;
+    inline unsigned enhanced_value(Skill::Skill skill_id) const;
+    inline unsigned skill_cd(Skill::Skill skill_id) const;
+    inline void reset_skill_modifiers();
 };
 //------------------------------------------------------------------------------
 // Represents a particular draw from a deck.
@@ -240,15 +408,13 @@ public:
 
     Hand(Deck* deck_) :
         deck(deck_),
-        assaults(15),
-        structures(15),
         stasis_faction_bitmap(0),
         total_cards_destroyed(0),
 	total_nonsummon_cards_destroyed(0)
     {
     }
 
-    void reset(std::mt19937& re);
+    void reset(RandomEngine& re);
 
     Deck* deck;
     CardStatus commander;
@@ -288,8 +454,14 @@ struct Quest
 class Field
 {
 public:
+    enum
+    {
+        max_field_units = 4 * max_storage_slots,  // assaults and structures of both players
+        max_queued_skills = 256,  // pending (on-death, on-attacked, BGE) skills
+    };
+
     bool end;
-    std::mt19937& re;
+    RandomEngine& re;
     const Cards& cards;
     // players[0]: the attacker, players[1]: the defender
     std::array<Hand*, 2> players;
@@ -297,7 +469,7 @@ public:
     unsigned tipi; // and inactive
     Hand* tap;
     Hand* tip;
-    std::vector<CardStatus*> selection_array;
+    InlineVector<CardStatus*, max_field_units> selection_array;
     unsigned turn;
     unsigned flexible_iter = 20;
     unsigned flexible_turn = 20;
@@ -313,9 +485,9 @@ public:
     std::vector<SkillSpec> bg_skills[2]; // active BGE, casted every turn
     // With the introduction of on death skills, a single skill can trigger arbitrary many skills.
     // They are stored in this, and cleared after all have been performed.
-    std::deque<std::tuple<CardStatus*, SkillSpec>> skill_queue;
-    std::vector<CardStatus*> killed_units;
-    std::map<CardStatus*, unsigned> damaged_units_to_times;
+    InlineQueue<std::tuple<CardStatus*, SkillSpec>, max_queued_skills> skill_queue;
+    InlineVector<CardStatus*, max_field_units> killed_units;
+    InlineCounter<CardStatus*, max_field_units> damaged_units_to_times;
 
 
     enum phase
@@ -341,8 +513,9 @@ public:
 #endif
 
     bool (&fixes)[Fix::num_fixes];// ;
+    DecisionCache* decision_cache; // flexible/evaluate decisions (optional, per thread)
 
-    Field(std::mt19937& re_, const Cards& cards_, Hand& hand1, Hand& hand2, gamemode_t gamemode_, OptimizationMode optimization_mode_,
+    Field(RandomEngine& re_, const Cards& cards_, Hand& hand1, Hand& hand2, gamemode_t gamemode_, OptimizationMode optimization_mode_,
 #ifndef NQUEST
             const Quest & quest_,
 #endif
@@ -373,18 +546,64 @@ public:
 #ifndef NQUEST
         quest_counter(0),
 #endif
-		fixes(fixes_)
+		fixes(fixes_),
+        decision_cache(nullptr)
     {
     }
 
+    // Start a new battle on this field (same hands, settings and BGEs);
+    // lets a simulation thread keep one Field per deck pair instead of building one per battle.
+    void reset()
+    {
+        end = false;
+        turn = 1;
+        selection_array.clear();
+        skill_queue.clear();
+        killed_units.clear();
+        damaged_units_to_times.clear();
+        assault_bloodlusted = false;
+        bloodlust_value = 0;
+#ifndef NQUEST
+        quest_counter = 0;
+#endif
+    }
+
+    // Snapshot/restore for rollouts (see Deck::next()): reset this field to the battle
+    // state of <src>, playing with hand1/hand2; containers keep their capacity.
+    void restore(const Field& src, Hand& hand1, Hand& hand2)
+    {
+        end = src.end;
+        players = {{&hand1, &hand2}};
+        tapi = src.tapi;
+        tipi = src.tipi;
+        tap = players[tapi];
+        tip = players[tipi];
+        selection_array.clear();
+        turn = src.turn;
+        flexible_iter = src.flexible_iter;
+        flexible_turn = src.flexible_turn;
+        eval_iter = src.eval_iter;
+        eval_turn = src.eval_turn;
+        skill_queue.clear();
+        killed_units.clear();
+        damaged_units_to_times.clear();
+        current_phase = src.current_phase;
+        current_ci = src.current_ci;
+        assault_bloodlusted = src.assault_bloodlusted;
+        bloodlust_value = src.bloodlust_value;
+#ifndef NQUEST
+        quest_counter = src.quest_counter;
+#endif
+    }
+
     inline unsigned rand(unsigned x, unsigned y)
     {
-        return(std::uniform_int_distribution<unsigned>(x, y)(re));
+        return(re.uniform(x, y));
     }
 
     inline unsigned flip()
     {
-        return(this->rand(0,1));
+        return(re.flip());
     }
 
     template <typename T>
@@ -5,10 +5,19 @@
 #define BOOST_TEST_DYN_LINK
 #define BOOST_TEST_MODULE sim
 
+#include <atomic>
 #include <chrono>
+#include <cstdlib>
+#include <new>
+#include <set>
 #include <boost/test/included/unit_test.hpp>
 #include <boost/test/data/test_case.hpp>
 #include <boost/test/data/monomorphic.hpp>
+#include <boost/filesystem.hpp>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 #include <iostream>
 #include <fstream>
 #include <iostream>
@@ -18,6 +27,12 @@
 #include "tyrant_optimize.h"
 #include "sim.h"
 #include "read.h"
+#include "cards.h"
+#include "deck.h"
+#include "xml.h"
+#include "binomial_bounds.h"
+#include "cards_cache.h"
+#include "daemon.h"
 
 using namespace std;
 namespace bdata = boost::unit_test::data;
@@ -30,6 +45,32 @@ double eps = 1;
 //enable
 //double eps = 0.0000001;
 
+// heap allocation counter for the allocation checks: counts while an AllocationCounter is alive
+std::atomic<unsigned> num_allocation_counters(0);
+std::atomic<uint64_t> num_allocations(0);
+// (the replacements stay out of line: inlined, gcc would pair the malloc()/free() inside them
+// with the new/delete expressions of the callers and report them as mismatched)
+__attribute__((noinline)) void* operator new(std::size_t size)
+{
+    if (num_allocation_counters) { ++ num_allocations; }
+    void* p = std::malloc(size ? size : 1);
+    if (!p) { throw std::bad_alloc(); }
+    return p;
+}
+__attribute__((noinline)) void* operator new[](std::size_t size) { return operator new(size); }
+__attribute__((noinline)) void operator delete(void* p) noexcept { std::free(p); }
+__attribute__((noinline)) void operator delete[](void* p) noexcept { operator delete(p); }
+__attribute__((noinline)) void operator delete(void* p, std::size_t) noexcept { operator delete(p); }
+__attribute__((noinline)) void operator delete[](void* p, std::size_t) noexcept { operator delete(p); }
+
+struct AllocationCounter {
+    AllocationCounter() : start(num_allocations) { ++ num_allocation_counters; }
+    ~AllocationCounter() { -- num_allocation_counters; }
+    uint64_t count() const { return num_allocations - start; }
+private:
+    uint64_t start;
+};
+
 //pipe output: https://stackoverflow.com/questions/5405016/can-i-check-my-programs-output-with-boost-test
 struct ios_redirect {
     ios_redirect( std::streambuf * new_buffer ,std::ostream& ios)
@@ -53,6 +94,22 @@ std::ostream& operator<<(std::ostream& os, const TestInfo& ti)
     return os << "Your Deck: " <<  ti.your_deck << "; Enemy Deck: " << ti.enemy_deck << "; BGE: " << ti.bge;
   }
 
+// the data of the tests (the default prefix), loaded once for all the runs
+inline TuoData& test_data()
+{
+    static TuoData data;
+    static bool loaded(false);
+    if (!loaded)
+    {
+        std::stringstream eoutput;
+        ios_redirect guard(eoutput.rdbuf(), std::cerr); //block warnings
+        fill_skill_table();
+        load_data(data);
+        loaded = true;
+    }
+    return data;
+}
+
 inline Result run_sim(int argc,const char** argv, bool pipe_output=true)
 {
     Result res;
@@ -77,7 +134,7 @@ inline Result run_sim(int argc,const char** argv, bool pipe_output=true)
             param[i] = const_cast<char*>(argv[i]);
           param[argc] = const_cast<char*>("-t");
           param[argc+1] = const_cast<char*>("1");
-        fr = run(argc+2,param);
+        fr = run(argc+2,param,&test_data());
     }
     else{
         //no guard here
@@ -89,7 +146,7 @@ inline Result run_sim(int argc,const char** argv, bool pipe_output=true)
             param[i] = const_cast<char*>(argv[i]);
           param[argc] = const_cast<char*>("-t");
           param[argc+1] = const_cast<char*>("1");
-        fr = run(argc+2,param);
+        fr = run(argc+2,param,&test_data());
     }
   }
 
@@ -112,25 +169,107 @@ inline void check_win_sim(TestInfo ti) {
     /////////////
     // Max. Iter == 100, else check_win fails with integer vs double equal in check_win
     ////////////
-    string s = std::to_string(iter);
-    char * ii = new char[s.length()];
-    strcpy(ii,s.c_str());
-    s = std::to_string(seed);
-    char * iii = new char[s.length()];
-    strcpy(iii,s.c_str());
-    const char* argv[] = {"tuo",ti.your_deck.c_str(),ti.enemy_deck.c_str(),"-e",ti.bge.c_str(),"sim", ii,"seed", iii}; //TODO hardcoded iterations? //much output on error?! // better 100 iterations for test, 10 for checking errors
+    string s_iter = std::to_string(iter);
+    string s_seed = std::to_string(seed);
+    const char* argv[] = {"tuo",ti.your_deck.c_str(),ti.enemy_deck.c_str(),"-e",ti.bge.c_str(),"sim", s_iter.c_str(),"seed", s_seed.c_str()}; //TODO hardcoded iterations? //much output on error?! // better 100 iterations for test, 10 for checking errors
     Result result(run_sim(sizeof(argv)/sizeof(*argv),argv));
-    delete ii;
-	delete iii;
     //result.second += "\nTest: " + ti.your_deck + "; " + ti.enemy_deck + "; " + ti.bge;
     check_win(result);
 }
 
+// deterministic mode: a climb (early stops included) gives the same results with any number of threads
+inline void check_deterministic_climb(TestInfo ti) {
+    auto climb = [&ti](const char* num_threads) -> FinalResults<long double> {
+        string s_iter = std::to_string(std::max(iter, 200));
+        string s_seed = std::to_string(seed);
+        const char* argv[] = {"tuo",ti.your_deck.c_str(),ti.enemy_deck.c_str(),"-e",ti.bge.c_str(),"climb", s_iter.c_str(),"seed", s_seed.c_str(),
+            "deterministic","sprt","0.05","0.05","-t",num_threads};
+        std::stringstream output;
+        std::stringstream eoutput;
+        ios_redirect guard1(output.rdbuf(), std::cout);
+        ios_redirect guard2(eoutput.rdbuf(), std::cerr);
+        return run(sizeof(argv)/sizeof(*argv), const_cast<char**>(argv), &test_data());
+    };
+    signed saved_debug_print = debug_print;
+    debug_print = 0; // the debug output is not thread safe
+    FinalResults<long double> one(climb("1"));
+    FinalResults<long double> more(climb("3"));
+    debug_print = saved_debug_print;
+    use_deterministic = false;
+    sprt_alpha = sprt_beta = 0;
+    BOOST_CHECK_MESSAGE(
+      one.wins == more.wins &&
+      one.losses == more.losses &&
+      one.points == more.points &&
+      one.n_sims == more.n_sims
+      , ti << ": " << one.points << " (" << one.n_sims << " sims) with 1 thread, " << more.points << " (" << more.n_sims << " sims) with 3");
+}
+
+// microbenchmark: once warm, play() must not allocate (prints allocations & time per battle)
+inline void check_play_allocations(TestInfo ti) {
+    TuoData& data(test_data());
+    Cards& all_cards(data.all_cards);
+    Decks& decks(data.decks);
+    std::stringstream eoutput;
+    ios_redirect guard(eoutput.rdbuf(),std::cerr); //block warnings
+    std::unique_ptr<Deck> your_deck(find_deck(decks, all_cards, ti.your_deck)->clone());
+    std::unique_ptr<Deck> enemy_deck(find_deck(decks, all_cards, ti.enemy_deck)->clone());
+    Hand your_hand(your_deck.get());
+    Hand enemy_hand(enemy_deck.get());
+    std::array<signed short, PassiveBGE::num_passive_bges> bg_effects[2]{};
+    std::vector<SkillSpec> bg_skills[2];
+    bool fixes[Fix::num_fixes]{};
+    RandomEngine re(seed);
+    signed saved_debug_print = debug_print;
+    debug_print = 0; // no (allocating) debug output while measuring
+    unsigned num_battles = std::max(iter, 100);
+    uint64_t allocations(0);
+    auto start_time = std::chrono::system_clock::now();
+    for (unsigned warm(0); warm < 2; ++ warm)
+    {
+        start_time = std::chrono::system_clock::now();
+        allocations = 0;
+        for (unsigned i(0); i < num_battles; ++ i)
+        {
+            your_hand.reset(re);
+            enemy_hand.reset(re);
+            Field fd(re, all_cards, your_hand, enemy_hand, fight, OptimizationMode::winrate,
+                    bg_effects[0], bg_effects[1], bg_skills[0], bg_skills[1], fixes);
+            AllocationCounter counter;
+            play(&fd);
+            allocations += counter.count();
+        }
+    }
+    debug_print = saved_debug_print;
+    std::chrono::duration<double> delta_t = (std::chrono::system_clock::now() - start_time);
+    BOOST_TEST_MESSAGE(ti << ": " << (double)allocations / num_battles << " allocations/play(), "
+        << delta_t.count() * 1e6 / num_battles << " us/play()");
+    BOOST_CHECK_MESSAGE(allocations == 0, ti << ": " << allocations << " heap allocations in " << num_battles << " warm play() calls");
+}
+
+// hot path check: once warm, a battle of 'sim' (Hand::reset(), SimulationData::evaluate(), play())
+// must not allocate, so a run with 1000 more battles allocates (almost, output buffers) the same
+inline void check_sim_allocations(TestInfo ti) {
+    signed saved_debug_print = debug_print;
+    debug_print = 0; // no (allocating) debug output while measuring
+    auto count_run = [&ti](unsigned num_sims) -> uint64_t {
+        string s_iter = std::to_string(num_sims);
+        string s_seed = std::to_string(seed);
+        const char* argv[] = {"tuo",ti.your_deck.c_str(),ti.enemy_deck.c_str(),"-e",ti.bge.c_str(),"sim", s_iter.c_str(),"seed", s_seed.c_str()};
+        AllocationCounter counter;
+        run_sim(sizeof(argv)/sizeof(*argv),argv);
+        return counter.count();
+    };
+    uint64_t base = count_run(iter);
+    uint64_t more = count_run(iter + 1000);
+    debug_print = saved_debug_print;
+    BOOST_TEST_MESSAGE(ti << ": " << (more > base ? more - base : 0) / 1000. << " allocations/battle");
+    BOOST_CHECK_MESSAGE(more <= base + 16, ti << ": " << more - base << " more heap allocations for 1000 more battles");
+}
+
 inline void genetic(std::string gnt1,std::string gnt2){
-    string s = std::to_string(iter);
-    char * ii = new char[s.length()];
-    strcpy(ii,s.c_str());
-    const char* argv[] = {"tuo",gnt1.c_str(),gnt2.c_str(),"brawl","genetic",ii};
+    string s_iter = std::to_string(iter);
+    const char* argv[] = {"tuo",gnt1.c_str(),gnt2.c_str(),"brawl","genetic",s_iter.c_str()};
     Result result(run_sim(sizeof(argv)/sizeof(*argv),argv,false));
     std::ofstream mf;
     mf.open("out.csv", std::ios_base::app);
@@ -164,6 +303,73 @@ std::vector<TestInfo> read_test_file(const std::string filename) {
     }
     return ret;
 }
+// tiny card data of its own (in a temporary directory, removed with it) for the tests that check the
+// loading of the data rather than the battles: visible sets 1-2, a commander, an assault with an abbreviation,
+// two assaults with the same name, a dominion shard and an alpha dominion it upgrades; a mission and one with an unknown card.
+// Loading it replaces the (global) dominion costs and refunds: they are restored with it.
+struct FixtureData {
+    boost::filesystem::path dir;
+    std::vector<std::map<const Card*, unsigned>> saved_dominion_cost, saved_dominion_refund;
+    FixtureData() : dir(boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("tuo-test-%%%%-%%%%")),
+        saved_dominion_cost(&dominion_cost[0][0], &dominion_cost[0][0] + sizeof(dominion_cost) / sizeof(dominion_cost[0][0])),
+        saved_dominion_refund(&dominion_refund[0][0], &dominion_refund[0][0] + sizeof(dominion_refund) / sizeof(dominion_refund[0][0]))
+    {
+        boost::filesystem::create_directories(dir / "data");
+        write("skills_set.xml",
+            "<root><cardSet><id>1</id><visible>1</visible></cardSet><cardSet><id>2</id><visible>1</visible></cardSet></root>\n");
+        write("cards_section_1.xml",
+            "<root>\n"
+            "<unit><id>1001</id><name>Fixture Commander</name><health>30</health><rarity>3</rarity><type>1</type><set>1</set>"
+                "<skill id=\"heal\" x=\"2\" all=\"1\"/>"
+                "<upgrade><card_id>1002</card_id><level>2</level><health>33</health></upgrade></unit>\n"
+            "<unit><id>1</id><name>Fixture Soldier</name><attack>2</attack><health>5</health><cost>1</cost><rarity>1</rarity><type>1</type><set>1</set>"
+                "<skill id=\"strike\" x=\"1\"/><skill id=\"enfeeble\" x=\"1\" trigger=\"play\"/>"
+                "<upgrade><card_id>2</card_id><level>2</level><attack>3</attack></upgrade></unit>\n"
+            "<unit><id>3</id><name>Fixture Twin</name><attack>1</attack><health>4</health><cost>1</cost><rarity>1</rarity><type>2</type><set>1</set></unit>\n"
+            "<unit><id>4</id><name>Fixture Twin</name><attack>1</attack><health>6</health><cost>1</cost><rarity>1</rarity><type>3</type><set>2</set></unit>\n"
+            "<unit><id>43451</id><name>Fixture Shard</name><health>1</health><rarity>1</rarity><type>1</type><set>1</set></unit>\n"
+            "<unit><id>50003</id><name>Fixture Dominion</name><health>10</health><rarity>4</rarity><type>1</type><set>1</set>"
+                "<upgrade><card_id>50004</card_id><level>2</level><health>12</health></upgrade></unit>\n"
+            "</root>\n");
+        write("levels.xml",
+            "<root><dominion_fusion_level><fusion_level>0</fusion_level><level><id>1</id>"
+            "<card_cost card_id=\"43451\" number=\"5\"/><card_refund card_id=\"43451\" number=\"2\"/>"
+            "</level></dominion_fusion_level></root>\n");
+        write("cardabbrs.txt", "fsol: Fixture Soldier\n");
+        write("missions.xml",
+            "<root>\n"
+            "<mission><id>1</id><name>Fixture Mission</name><commander>1001</commander><levels>2</levels><deck><card>2</card><card>2</card></deck></mission>\n"
+            "<mission><id>2</id><name>Fixture Broken Mission</name><commander>1001</commander><levels>2</levels><deck><card>999</card></deck></mission>\n"
+            "</root>\n");
+    }
+    ~FixtureData()
+    {
+        std::copy(saved_dominion_cost.begin(), saved_dominion_cost.end(), &dominion_cost[0][0]);
+        std::copy(saved_dominion_refund.begin(), saved_dominion_refund.end(), &dominion_refund[0][0]);
+        boost::system::error_code ec;
+        boost::filesystem::remove_all(dir, ec);
+    }
+    std::string prefix() const { return dir.string() + "/"; }
+    std::string file(const std::string& name) const { return (dir / "data" / name).string(); }
+    void write(const std::string& name, const std::string& content, std::ios::openmode mode = std::ios::trunc) const
+    {
+        std::ofstream out(file(name), std::ios::binary | mode);
+        out << content;
+    }
+    // loads it like run() does (fill_skill_table() first: the XML refers to the skills by name)
+    void load(TuoData& data, bool cache) const
+    {
+        std::stringstream eoutput;
+        ios_redirect guard(eoutput.rdbuf(), std::cerr);
+        fill_skill_table();
+        bool saved_use_cards_cache = use_cards_cache;
+        use_cards_cache = cache;
+        data.prefix = prefix();
+        load_data(data);
+        use_cards_cache = saved_use_cards_cache;
+    }
+};
+
 /*
 BOOST_AUTO_TEST_SUITE(test_climb) // bench_climb
 BOOST_AUTO_TEST_CASE(test_climb_init)
@@ -235,6 +441,450 @@ BOOST_DATA_TEST_CASE(test_whole_decks,bdata::make(read_test_file("tests/test_who
 BOOST_AUTO_TEST_SUITE_END()
 
 
+BOOST_AUTO_TEST_SUITE(test_crn)
+BOOST_AUTO_TEST_CASE(test_paired_stop)
+{
+    // mean difference -2 (sd ~10) cannot beat the incumbent, +2 can; too few pairs never stop
+    auto pairs = [](unsigned n, double mean) -> PairedSums {
+        return PairedSums{n, n * mean, n * (mean * mean + 100.)};
+    };
+    const long double saved_confidence_level(confidence_level), saved_min_increment(min_increment_of_score), saved_sprt_alpha(sprt_alpha);
+    confidence_level = 0.99;
+    min_increment_of_score = 0;
+    sprt_alpha = 0;
+    BOOST_CHECK(compare_can_stop(pairs(1000, -2.)));
+    BOOST_CHECK(!compare_can_stop(pairs(1000, 2.)));
+    BOOST_CHECK(!compare_can_stop(pairs(10, -2.)));
+    confidence_level = saved_confidence_level;
+    min_increment_of_score = saved_min_increment;
+    sprt_alpha = saved_sprt_alpha;
+}
+BOOST_AUTO_TEST_CASE(test_paired_battles)
+{
+    // two close decks against the same enemy: battle #i of both is the same battle, so that the differences
+    // of their battles paired by the incumbent vary far less than the scores of either deck
+    FixtureData fixture;
+    TuoData data;
+    fixture.load(data, false);
+    const bool saved_use_crn(use_crn);
+    const unsigned saved_sim_seed(sim_seed);
+    const OptimizationMode saved_optimization_mode(optimization_mode);
+    use_crn = true;
+    sim_seed = 1;
+    optimization_mode = OptimizationMode::winrate;
+    std::unique_ptr<Deck> your_deck(find_deck(data.decks, data.all_cards, "Fixture Commander, Fixture Soldier-1#2, [3]")->clone());
+    std::unique_ptr<Deck> other_deck(find_deck(data.decks, data.all_cards, "Fixture Commander, Fixture Soldier-1#2, [4]")->clone());
+    std::unique_ptr<Deck> enemy_deck(find_deck(data.decks, data.all_cards, "Fixture Commander, Fixture Soldier-1#2")->clone());
+    std::array<signed short, PassiveBGE::num_passive_bges> bg_effects[2]{};
+    std::vector<SkillSpec> bg_skills[2];
+    const unsigned num_battles(2000);
+    EvaluatedResults incumbent_results{EvaluatedResults::first_type(1), 0}, results{EvaluatedResults::first_type(1), 0};
+    PairedSums sums{0, 0, 0};
+    double incumbent_variance(0), variance(0);
+    {
+        std::stringstream output;
+        ios_redirect guard(output.rdbuf(), std::cout); // RNG seed
+        Process proc(1, data.all_cards, data.decks, {your_deck.get()}, {enemy_deck.get()}, {1}, fight,
+            bg_effects[0], bg_effects[1], bg_skills[0], bg_skills[1]);
+        proc.evaluate(num_battles, incumbent_results);
+        proc.set_crn_incumbent(&incumbent_results);
+        BOOST_CHECK(proc.crn_incumbent_points(num_battles / 2, -1) >= 0); // all its battles are recorded
+        your_deck->cards = other_deck->cards;
+        proc.evaluate(num_battles, results);
+        const CrnRun& run(proc.crn_runs.at(&results));
+        run.add_pairs(0, num_battles, sums);
+        auto score_variance = [num_battles](const std::vector<double>& scores) {
+            double sum(0), sq_sum(0);
+            for (double score: scores) { sum += score; sq_sum += score * score; }
+            return (sq_sum - sum * sum / num_battles) / (num_battles - 1);
+        };
+        incumbent_variance = score_variance(proc.crn_incumbent_scores);
+        variance = score_variance(run.scores);
+    }
+    use_crn = saved_use_crn;
+    sim_seed = saved_sim_seed;
+    optimization_mode = saved_optimization_mode;
+
+    BOOST_REQUIRE_EQUAL(sums.pairs, num_battles);
+    BOOST_CHECK_CLOSE(sums.sum, static_cast<double>(results.first[0].points) - incumbent_results.first[0].points, 1e-6);
+    const double paired_variance = (sums.sq_sum - sums.sum * sums.sum / num_battles) / (num_battles - 1);
+    BOOST_TEST_MESSAGE("variance of the paired differences: " << paired_variance << ", unpaired: " << incumbent_variance + variance);
+    // the battles needed for the same confidence go down by that ratio
+    BOOST_CHECK_LT(paired_variance, 0.5 * (incumbent_variance + variance));
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_decision_cache)
+BOOST_AUTO_TEST_CASE(test_decision_cache)
+{
+    // the flexible decisions of a deck pair hit the cache, more so once it is kept from a previous run
+    FixtureData fixture;
+    TuoData data;
+    fixture.load(data, false);
+    const unsigned saved_cache_size(flexible_cache_size), saved_iter(flexible_iter), saved_turn(flexible_turn);
+    const OptimizationMode saved_optimization_mode(optimization_mode);
+    signed saved_debug_print = debug_print;
+    debug_print = 0; // no debug output of the rollouts
+    flexible_cache_size = 1 << 16;
+    flexible_iter = 20;
+    flexible_turn = 10;
+    optimization_mode = OptimizationMode::winrate;
+    std::unique_ptr<Deck> your_deck(find_deck(data.decks, data.all_cards, "Fixture Commander, Fixture Soldier-1#3, [3]#3, [4]#2, Fixture Soldier#2")->clone());
+    std::unique_ptr<Deck> enemy_deck(find_deck(data.decks, data.all_cards, "Fixture Commander, Fixture Soldier-1#4, [3]#3, [4]#3")->clone());
+    your_deck->strategy = DeckStrategy::flexible;
+    std::array<signed short, PassiveBGE::num_passive_bges> bg_effects[2]{};
+    std::vector<SkillSpec> bg_skills[2];
+    EvaluatedResults results{EvaluatedResults::first_type(1), 0};
+    uint64_t first_hits(0), first_lookups(0), hits(0), lookups(0);
+    {
+        std::stringstream output;
+        ios_redirect guard(output.rdbuf(), std::cout); // RNG seed
+        Process proc(1, data.all_cards, data.decks, {your_deck.get()}, {enemy_deck.get()}, {1}, fight,
+            bg_effects[0], bg_effects[1], bg_skills[0], bg_skills[1]);
+        const DecisionCache& cache(proc.threads_data[0]->decision_cache);
+        proc.evaluate(1000, results);
+        first_hits = cache.hits;
+        first_lookups = cache.hits + cache.misses;
+        proc.evaluate(2000, results);
+        hits = cache.hits - first_hits;
+        lookups = cache.hits + cache.misses - first_lookups;
+    }
+    debug_print = saved_debug_print;
+    flexible_cache_size = saved_cache_size;
+    flexible_iter = saved_iter;
+    flexible_turn = saved_turn;
+    optimization_mode = saved_optimization_mode;
+
+    BOOST_REQUIRE(first_lookups > 0 && lookups > 0);
+    BOOST_TEST_MESSAGE("decision cache hit rate: " << 100.0 * first_hits / first_lookups << "% in the first run, "
+        << 100.0 * hits / lookups << "% in the second one");
+    BOOST_CHECK_GT(first_hits, 0u);
+    BOOST_CHECK_GT(hits * first_lookups, first_hits * lookups);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_deterministic)
+BOOST_DATA_TEST_CASE(test_deterministic_climb,bdata::make(read_test_file("tests/test_whole_decks.csv")),ti)
+{
+   check_deterministic_climb(ti);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_allocations)
+BOOST_DATA_TEST_CASE(test_play_allocations,bdata::make(read_test_file("tests/test_whole_decks.csv")),ti)
+{
+   check_play_allocations(ti);
+}
+BOOST_DATA_TEST_CASE(test_sim_allocations,bdata::make(read_test_file("tests/test_whole_decks.csv")),ti)
+{
+   check_sim_allocations(ti);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_bounds)
+BOOST_AUTO_TEST_CASE(test_bounds)
+{
+    // memoized bounds are boost's; the closed form stays close to them
+    for (unsigned trials: {10u, 100u, 1000u, 10000u})
+    {
+        for (double p: {0.0, 0.05, 0.3, 0.5, 0.83, 1.0})
+        {
+            double successes = p * trials;
+            auto bounds = clopper_pearson_bounds(trials, successes, 0.01);
+            BOOST_CHECK_EQUAL(bounds.lower, boost::math::binomial_distribution<>::find_lower_bound_on_p(trials, successes, 0.01));
+            BOOST_CHECK_EQUAL(bounds.upper, boost::math::binomial_distribution<>::find_upper_bound_on_p(trials, successes, 0.01));
+            auto cached = clopper_pearson_bounds(trials, successes, 0.01);
+            BOOST_CHECK_EQUAL(cached.lower, bounds.lower);
+            BOOST_CHECK_EQUAL(cached.upper, bounds.upper);
+            auto wilson = wilson_bounds(trials, successes, 0.01);
+            double tolerance = (trials >= 100) ? 2.5 / trials + 0.005 : 0.1;
+            BOOST_CHECK_SMALL(wilson.lower - bounds.lower, tolerance);
+            BOOST_CHECK_SMALL(wilson.upper - bounds.upper, tolerance);
+        }
+    }
+    // the early stop check takes the same decisions as the exact bound
+    for (double alpha: {0.0001, 0.01, 0.2})
+    {
+        for (unsigned trials: {1u, 7u, 100u, 2500u, 100000u})
+        {
+            for (double p: {0.0, 0.001, 0.05, 0.3, 0.5, 0.83, 0.999, 1.0})
+            {
+                double successes = p * trials;
+                double upper = boost::math::binomial_distribution<>::find_upper_bound_on_p(trials, successes, alpha);
+                for (double threshold: {upper - 1e-3, upper - 1e-9, upper + 1e-9, upper + 1e-3})
+                {
+                    BOOST_CHECK_EQUAL(clopper_pearson_upper_below(trials, successes, alpha, threshold), upper < threshold);
+                }
+            }
+        }
+    }
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+// the cards of two loads (the cards as ids) and the dominion costs and refunds, for the cards cache
+inline std::vector<std::string> card_snapshot(const Cards& all_cards)
+{
+    std::vector<std::string> snapshot;
+    auto counts = [](const std::map<const Card*, unsigned>& card_counts) {
+        std::ostringstream os;
+        for (const auto& count: card_counts) { os << count.first->m_id << "x" << count.second << " "; }
+        return os.str();
+    };
+    auto skills = [](const std::vector<SkillSpec>& skill_specs) {
+        std::ostringstream os;
+        for (const auto& ss: skill_specs)
+        { os << ss.id << "/" << ss.x << "/" << ss.y << "/" << ss.n << "/" << ss.c << "/" << ss.s << "/" << ss.s2 << "/" << ss.all << "/" << ss.card_id << " "; }
+        return os.str();
+    };
+    for (const Card* card: all_cards.all_cards)
+    {
+        std::ostringstream os;
+        os << card->m_id << " " << card->m_name << " " << card->m_base_id << " " << card->m_attack << " " << card->m_health
+            << " " << card->m_delay << " " << card->m_faction << " " << card->m_level << " " << card->m_fusion_level
+            << " " << card->m_rarity << " " << card->m_set << " " << card->m_type << " " << card->m_category
+            << " top " << card->m_top_level_card->m_id << " recipe " << card->m_recipe_cost << ": " << counts(card->m_recipe_cards)
+            << "used for " << counts(card->m_used_for_cards)
+            << "skills " << skills(card->m_skills) << "| " << skills(card->m_skills_on_play)
+            << "| " << skills(card->m_skills_on_attacked) << "| " << skills(card->m_skills_on_death) << "|";
+        for (unsigned id(0); id < Skill::num_skills; ++id)
+        {
+            if (card->m_skill_value[id] || card->m_skill_trigger[id])
+            { os << " " << id << "=" << card->m_skill_value[id] << "@" << card->m_skill_trigger[id]; }
+        }
+        snapshot.push_back(os.str());
+    }
+    for (const auto& name: all_cards.cards_by_name)
+    { snapshot.push_back("name " + name.first + " " + to_string(name.second->m_id)); }
+    for (const auto& abbr: all_cards.player_cards_abbr)
+    { snapshot.push_back("abbr " + abbr.first + " " + abbr.second); }
+    std::set<std::string> ambiguous_names(all_cards.ambiguous_names.begin(), all_cards.ambiguous_names.end());
+    for (const auto& name: ambiguous_names)
+    { snapshot.push_back("ambiguous " + name); }
+    for (const auto* card_list: {&all_cards.player_commanders, &all_cards.player_assaults, &all_cards.player_structures})
+    {
+        std::ostringstream os;
+        os << "player cards";
+        for (const Card* card: *card_list) { os << " " << card->m_id; }
+        snapshot.push_back(os.str());
+    }
+    for (unsigned fusion_level(0); fusion_level < std::extent<decltype(dominion_cost)>::value; ++fusion_level)
+    {
+        for (unsigned level(0); level < std::extent<decltype(dominion_cost), 1>::value; ++level)
+        {
+            snapshot.push_back("dominion " + to_string(fusion_level) + "/" + to_string(level) + ": "
+                + counts(dominion_cost[fusion_level][level]) + "/ " + counts(dominion_refund[fusion_level][level]));
+        }
+    }
+    return snapshot;
+}
+
+BOOST_AUTO_TEST_SUITE(test_cards_cache)
+BOOST_AUTO_TEST_CASE(test_cards_cache_round_trip)
+{
+    FixtureData fixture;
+    const std::string cache_filename(fixture.file("cards_cache.bin"));
+    const std::vector<std::string> sources{fixture.file("skills_set.xml"), fixture.file("levels.xml"), fixture.file("cards_section_1.xml")};
+
+    // from the XML (saving the cache), then from the cache
+    TuoData xml_data;
+    fixture.load(xml_data, true);
+    auto xml_snapshot = card_snapshot(xml_data.all_cards);
+    BOOST_REQUIRE_EQUAL(xml_data.all_cards.all_cards.size(), 9u);
+    BOOST_REQUIRE(boost::filesystem::exists(cache_filename));
+    BOOST_CHECK_EQUAL(std::distance(boost::filesystem::directory_iterator(fixture.dir / "data"), boost::filesystem::directory_iterator()), 6);
+    {
+        Cards cached_cards;
+        BOOST_CHECK(load_cards_cache(cached_cards, cache_filename, sources));
+    }
+    TuoData cached_data;
+    fixture.load(cached_data, true);
+    auto cached_snapshot = card_snapshot(cached_data.all_cards);
+    BOOST_CHECK_EQUAL_COLLECTIONS(xml_snapshot.begin(), xml_snapshot.end(), cached_snapshot.begin(), cached_snapshot.end());
+    BOOST_CHECK(cached_data.all_cards.find_name("fsol", "fsol" + 4) && cached_data.all_cards.find_name("fsol", "fsol" + 4)->abbr);
+
+    // a cache that cannot be used is reported, and all_cards is left empty
+    auto check_rejected = [&](const std::string& reason) {
+        std::stringstream eoutput;
+        Cards rejected_cards;
+        {
+            ios_redirect guard(eoutput.rdbuf(), std::cerr);
+            BOOST_CHECK(!load_cards_cache(rejected_cards, cache_filename, sources));
+        }
+        BOOST_CHECK_MESSAGE(eoutput.str().find("WARNING") != std::string::npos && eoutput.str().find(reason) != std::string::npos, eoutput.str());
+        BOOST_CHECK(rejected_cards.all_cards.empty());
+    };
+    fixture.write("levels.xml", "\n", std::ios::app);
+    check_rejected("does not match the XML files");
+    {
+        std::fstream cache(cache_filename, std::ios::binary | std::ios::in | std::ios::out);
+        cache.seekp(8); // the format, after the magic
+        cache.write("\xff\xff\xff\xff", 4);
+    }
+    check_rejected("of another version");
+    fixture.write("cards_cache.bin", "not a cache");
+    check_rejected("is not a cards cache");
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+BOOST_AUTO_TEST_SUITE(test_decks)
+BOOST_AUTO_TEST_CASE(test_card_names)
+{
+    FixtureData fixture;
+    TuoData data;
+    fixture.load(data, false);
+    const Cards& all_cards(data.all_cards);
+    auto parse = [&all_cards](const std::string& card_spec, unsigned& card_num, char& mark, std::string& warnings) -> unsigned {
+        unsigned card_id(0);
+        char num_sign(0);
+        std::stringstream eoutput;
+        ios_redirect guard(eoutput.rdbuf(), std::cerr);
+        parse_card_spec(all_cards, card_spec, card_id, card_num, num_sign, mark);
+        warnings = eoutput.str();
+        return card_id;
+    };
+    unsigned card_num(0);
+    char mark(0);
+    std::string warnings;
+
+    // names are simplified; a plain name is the top level card, "-<level>" the others
+    BOOST_CHECK_EQUAL(parse(" fixture  SOLDIER #3", card_num, mark, warnings), 2u);
+    BOOST_CHECK_EQUAL(card_num, 3u);
+    BOOST_CHECK_EQUAL(mark, 0);
+    BOOST_CHECK_EQUAL(parse("Fixture Soldier-1", card_num, mark, warnings), 1u);
+
+    // abbreviation (cardabbrs.txt): looked up by the name it stands for
+    const std::string abbr("FSol");
+    const Cards::NameSlot* slot = all_cards.find_name(abbr.data(), abbr.data() + abbr.size());
+    BOOST_REQUIRE(slot && slot->abbr);
+    BOOST_CHECK_EQUAL(*slot->abbr, "Fixture Soldier");
+    BOOST_CHECK_EQUAL(parse("FSol(2)", card_num, mark, warnings), 2u);
+    BOOST_CHECK_EQUAL(card_num, 2u);
+
+    // ambiguous name (two visible cards): the first one, with a warning
+    const std::string twin("Fixture Twin");
+    slot = all_cards.find_name(twin.data(), twin.data() + twin.size());
+    BOOST_REQUIRE(slot && slot->card);
+    BOOST_CHECK(slot->ambiguous);
+    BOOST_CHECK_EQUAL(parse(twin, card_num, mark, warnings), 3u);
+    BOOST_CHECK_MESSAGE(warnings.find("multiple cards named Fixture Twin") != std::string::npos, warnings);
+    BOOST_CHECK_EQUAL(parse("Fixture Soldier", card_num, mark, warnings), 2u);
+    BOOST_CHECK(warnings.empty());
+
+    // !name: marked card
+    BOOST_CHECK_EQUAL(parse("!Fixture Commander", card_num, mark, warnings), 1002u);
+    BOOST_CHECK_EQUAL(mark, '!');
+
+    // name[id]: the id when the name is not known (the other Fixture Twin, or any name)
+    BOOST_CHECK_EQUAL(parse("Fixture Twin[4]", card_num, mark, warnings), 4u);
+    BOOST_CHECK_EQUAL(mark, 0);
+    BOOST_CHECK_EQUAL(parse("Whatever[43451]#2", card_num, mark, warnings), 43451u);
+    BOOST_CHECK_EQUAL(card_num, 2u);
+    BOOST_CHECK_EQUAL(parse("[1001]", card_num, mark, warnings), 1001u);
+
+    BOOST_CHECK_THROW(parse("No Such Card", card_num, mark, warnings), std::runtime_error);
+    const std::string unknown("No Such Card");
+    BOOST_CHECK(all_cards.find_name(unknown.data(), unknown.data() + unknown.size()) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_deck_regex)
+{
+    FixtureData fixture;
+    TuoData data;
+    fixture.load(data, false);
+    std::stringstream eoutput;
+    ios_redirect guard(eoutput.rdbuf(), std::cerr);
+    const std::string regex_string("^fixture.*mission$");
+    BOOST_CHECK_EQUAL(data.decks.find_deck_names(regex_string).size(), 2u);
+    // the mission that fails to build is skipped, and no longer matches
+    auto decklist = parse_deck_list("/" + regex_string + "/", data.decks);
+    BOOST_REQUIRE_EQUAL(decklist.size(), 1u);
+    BOOST_CHECK_EQUAL(decklist.begin()->first, "fixturemission");
+    BOOST_CHECK_EQUAL(decklist.begin()->second, 1);
+    const auto& names = data.decks.find_deck_names(regex_string);
+    BOOST_CHECK(names == std::vector<std::string>{"fixturemission"});
+    BOOST_CHECK(data.decks.find_deck_by_name("Fixture Broken Mission") == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(test_custom_deck_conflict)
+{
+    FixtureData fixture;
+    TuoData data;
+    fixture.load(data, false);
+    fixture.write("customdecks.txt", "Fixture Custom: Fixture Commander, Fixture Soldier\n"
+        "Fixture Custom: Fixture Commander, Fixture Soldier#2\n");
+    std::stringstream eoutput;
+    ios_redirect guard(eoutput.rdbuf(), std::cerr);
+    size_t num_decks(data.decks.decks.size());
+    BOOST_CHECK_EQUAL(load_custom_decks(data.decks, data.all_cards, fixture.file("customdecks.txt")), 0u);
+    // the conflict is reported without building the deck of the first line
+    BOOST_CHECK_MESSAGE(eoutput.str().find("name conflicts, overrides Fixture Custom") != std::string::npos, eoutput.str());
+    BOOST_CHECK_EQUAL(data.decks.decks.size(), num_decks);
+    BOOST_CHECK(data.decks.has_deck_name("fixture custom"));
+    BOOST_CHECK(data.decks.find_built_deck_by_name("Fixture Custom") == nullptr);
+    Deck* deck = data.decks.find_deck_by_name("Fixture Custom");
+    BOOST_REQUIRE(deck != nullptr);
+    deck->resolve();
+    BOOST_CHECK_EQUAL(deck->cards.size(), 2u);
+    BOOST_CHECK(data.decks.find_built_deck_by_name("Fixture Custom") == deck);
+}
+BOOST_AUTO_TEST_SUITE_END()
+
+#ifndef _WIN32
+BOOST_AUTO_TEST_SUITE(test_daemon)
+BOOST_AUTO_TEST_CASE(test_daemon_requests)
+{
+    FixtureData fixture;
+    TuoData data;
+    fixture.load(data, false);
+    const std::string prefix_arg(" prefix \"" + fixture.prefix() + "\" -t 1");
+    fixture.write("requests.txt",
+        "\"Fixture Commander, Fixture Soldier#3\" \"Fixture Commander, Fixture Twin\" sim 20 seed 1" + prefix_arg + "\n"
+        "# a comment\n"
+        "\"Fixture Commander\" \"No Such Deck\" sim 20" + prefix_arg + "\n"
+        "\"Fixture Commander, Fixture Soldier\" \"Fixture Commander:0\" sim 20 seed 1 -t 1\n" // the daemon's prefix
+        "bad\\q request\n"
+        "quit\n"
+        "\"Fixture Commander\" \"Fixture Commander\" sim 20" + prefix_arg + "\n");
+    int in_fd = open(fixture.file("requests.txt").c_str(), O_RDONLY);
+    int out_fd = open(fixture.file("responses.txt").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    BOOST_REQUIRE(in_fd >= 0 && out_fd >= 0);
+    BOOST_CHECK(!serve_daemon_requests(data, in_fd, out_fd)); // quit
+    close(in_fd);
+    close(out_fd);
+
+    // the ready line, then the output and the end of every request (in order)
+    std::vector<std::string> lines, done_lines;
+    std::ifstream responses(fixture.file("responses.txt"));
+    for (std::string line; std::getline(responses, line); )
+    {
+        lines.push_back(line);
+        BOOST_CHECK_MESSAGE(line.front() == '{' && line.back() == '}', line);
+        if (line.find("\"done\":true") != std::string::npos)
+        {
+            done_lines.push_back(line);
+            BOOST_CHECK_MESSAGE(line.find("nan") == std::string::npos && line.find("inf") == std::string::npos, line);
+        }
+    }
+    BOOST_REQUIRE(!lines.empty());
+    BOOST_CHECK_EQUAL(lines.front(), "{\"ready\":true,\"cards\":9,\"deck_names\":" + to_string(data.decks.num_deck_names()) + "}");
+    BOOST_REQUIRE_EQUAL(done_lines.size(), 4u);
+    BOOST_CHECK_MESSAGE(done_lines[0].find("{\"id\":1,\"done\":true,\"exit_status\":0,\"result\":{\"points\":") == 0
+        && done_lines[0].find("\"n_sims\":20}") != std::string::npos, done_lines[0]);
+    BOOST_CHECK_MESSAGE(done_lines[1].find("{\"id\":2,\"done\":true,\"exit_status\":1}") == 0, done_lines[1]);
+    // no score against decks of factor 0: null, not nan
+    BOOST_CHECK_MESSAGE(done_lines[2].find("{\"id\":3,\"done\":true,\"exit_status\":0,\"result\":{\"points\":null,"
+        "\"points_lower_bound\":null,\"points_upper_bound\":null,") == 0, done_lines[2]);
+    BOOST_CHECK_MESSAGE(done_lines[3].find("{\"id\":4,\"done\":true,\"error\":\"bad request: ") == 0, done_lines[3]);
+    BOOST_CHECK(std::any_of(lines.begin(), lines.end(), [](const std::string& line) {
+        return line.find("{\"id\":1,\"stream\":\"stdout\",\"line\":") == 0; }));
+    BOOST_CHECK(std::any_of(lines.begin(), lines.end(), [](const std::string& line) {
+        return line.find("{\"id\":2,\"stream\":\"stderr\",\"line\":") == 0; }));
+    BOOST_CHECK(std::none_of(lines.begin(), lines.end(), [](const std::string& line) {
+        return line.find("loading them again") != std::string::npos; }));
+}
+BOOST_AUTO_TEST_SUITE_END()
+#endif
+
 BOOST_AUTO_TEST_SUITE(test_crashes)
 BOOST_AUTO_TEST_CASE(test_crashes)
 {
@@ -0,0 +1,34 @@
+#!/bin/bash
+
+# Thread scaling report: sims the same battles (fixed seed) with 1..N threads
+# and prints the wall time, the throughput and the speedup over 1 thread.
+# The results (win%) must be the same on every line.
+#
+# usage: thread-scaling.sh "Your_Deck" "Enemy_Deck" [max_threads] [sims] [-- extra tuo options]
+
+TUO="${TUO:-./tuo}"
+YOUR_DECK="$1"
+ENEMY_DECK="$2"
+declare -i MAX_THREADS="${3:-$(nproc)}"
+declare -i SIMS="${4:-100000}"
+shift 4 2>/dev/null || shift $#
+[[ $1 == "--" ]] && shift
+TUO_OPTIONS=("$@")
+
+if [[ -z $YOUR_DECK || -z $ENEMY_DECK ]]; then
+    echo "usage: $0 \"Your_Deck\" \"Enemy_Deck\" [max_threads] [sims] [-- extra tuo options]" >&2
+    exit 1
+fi
+
+echo "cpus: $(nproc), sims: $SIMS"
+printf "%8s %10s %12s %8s  %s\n" threads seconds sims/s speedup result
+base_seconds=""
+for (( threads = 1; threads <= MAX_THREADS; ++threads )); do
+    start=$(date +%s.%N)
+    result=$("$TUO" "$YOUR_DECK" "$ENEMY_DECK" "${TUO_OPTIONS[@]}" -t "$threads" seed 1 sim "$SIMS" | grep -m1 '^win%')
+    end=$(date +%s.%N)
+    seconds=$(echo "$end - $start" | bc -l)
+    [[ -z $base_seconds ]] && base_seconds=$seconds
+    printf "%8d %10.2f %12.0f %8.2f  %s\n" "$threads" "$seconds" "$(echo "$SIMS / $seconds" | bc -l)" \
+        "$(echo "$base_seconds / $seconds" | bc -l)" "$result"
+done
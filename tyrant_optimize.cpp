@@ -20,9 +20,11 @@
 #include <ctime>
 #include <functional>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <unordered_map>
 #include <set>
+#include <sstream>
 #include <stack>
 #include <string>
 #include <tuple>
@@ -39,8 +41,11 @@
 #include <boost/thread/thread.hpp>
 #include <boost/timer/timer.hpp>
 #include <boost/tokenizer.hpp>
+#include "binomial_bounds.h"
 #include "card.h"
 #include "cards.h"
+#include "cards_cache.h"
+#include "daemon.h"
 #include "deck.h"
 #include "read.h"
 #include "sim.h"
@@ -55,6 +60,10 @@
 #endif
 
 // Android Headers
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
 #if defined(ANDROID) || defined(__ANDROID__)
 #include <jni.h>
 #include <android/log.h>
@@ -81,6 +90,9 @@ namespace tuo {
 	long double target_score{100};
 	long double min_increment_of_score{0};
 	long double confidence_level{0.99};
+	long double sprt_alpha{0};
+	long double sprt_beta{0};
+	long double sprt_delta{0.02};
 	bool use_top_level_card{true};
 	bool use_top_level_commander{true};
 	bool mode_open_the_deck{false};
@@ -94,9 +106,17 @@ namespace tuo {
 	bool show_ci{false};
 	bool use_harmonic_mean{false};
 	unsigned iterations_multiplier{10};
+	unsigned climb_speculative{1};
+	bool use_crn{false};
+	bool use_deterministic{false};
+	bool use_affinity{false};
+	unsigned telemetry_interval{0};
+	std::string telemetry_file;
+	bool use_cards_cache{true};
 	unsigned sim_seed{0};
 	unsigned flexible_iter{20};
 	unsigned flexible_turn{10};
+	unsigned flexible_cache_size{0};
 	Requirement requirement;
 #ifndef NQUEST
 	Quest quest;
@@ -141,6 +161,14 @@ void init()
 	thread_best_results=nullptr;
 	thread_compare=false;
 	thread_compare_stop=false; // written by threads
+	thread_run_seed=0;
+	thread_next_battle=0;
+	thread_claimed_battles=0; // written by threads
+	thread_chunk_size=1;
+	thread_batch_runs=nullptr;
+	thread_batch_accepted=nullptr;
+	thread_crn_run=nullptr;
+	thread_ordered=nullptr;
 	destroy_threads;
 	opt_num_threads=4;
 	gamemode = fight;
@@ -158,6 +186,9 @@ void init()
 	target_score=100;
 	min_increment_of_score=0;
 	confidence_level=0.99;
+	sprt_alpha=0;
+	sprt_beta=0;
+	sprt_delta=0.02;
 	use_top_level_card=true;
 	use_top_level_commander=true;
 	mode_open_the_deck=false;
@@ -171,9 +202,17 @@ void init()
 	show_ci=false;
 	use_harmonic_mean=false;
 	iterations_multiplier=10;
+	climb_speculative=1;
+	use_crn=false;
+	use_deterministic=false;
+	use_affinity=false;
+	telemetry_interval=0;
+	telemetry_file.clear();
+	use_cards_cache=true;
 	sim_seed=0;
 	flexible_iter=20;
 	flexible_turn=20;
+	flexible_cache_size=0;
 	eval_iter=8;
 	eval_turn=8;
 	requirement.num_cards.clear();
@@ -603,8 +642,9 @@ FinalResults<long double> compute_score(const EvaluatedResults& results, std::ve
 			_DEBUG_MSG(2,"WARNING: biominal successes > trials");
 		}
 
-		auto lower_bound = boost::math::binomial_distribution<>::find_lower_bound_on_p(trials, successes, prob) * max_possible;
-		auto upper_bound = boost::math::binomial_distribution<>::find_upper_bound_on_p(trials, successes, prob) * max_possible;
+		auto bounds = clopper_pearson_bounds(trials, successes, prob);
+		long double lower_bound = bounds.lower * max_possible;
+		long double upper_bound = bounds.upper * max_possible;
 		if (use_harmonic_mean)
 		{
 			final.points += factors[index] / results.first[index].points;
@@ -643,6 +683,17 @@ FinalResults<long double> compute_score(const EvaluatedResults& results, std::ve
 // d1 and d2 are intended to point to read-only process-wide data.
 
 
+	std::shared_ptr<Field> SimulationData::make_field(RandomEngine& re, Hand& your_hand, Hand& enemy_hand)
+	{
+		std::shared_ptr<Field> fd(new Field(re, cards, your_hand, enemy_hand, gamemode, optimization_mode,
+#ifndef NQUEST
+					quest,
+#endif
+					your_bg_effects, enemy_bg_effects, your_bg_skills, enemy_bg_skills,fixes, flexible_iter,flexible_turn, eval_iter,eval_turn));
+		fd->decision_cache = &decision_cache;
+		return fd;
+	}
+
 	void SimulationData::set_decks(std::vector<Deck*> const your_decks_, std::vector<Deck*> const & enemy_decks_)
 	{
 		for (unsigned i(0); i < your_decks_.size(); ++i)
@@ -655,23 +706,85 @@ FinalResults<long double> compute_score(const EvaluatedResults& results, std::ve
 			enemy_decks[i].reset(enemy_decks_[i]->clone());
 			enemy_hands[i]->deck = enemy_decks[i].get();
 		}
+		fields.clear();
+		for (Hand* your_hand : your_hands)
+		{
+			for (Hand* enemy_hand: enemy_hands)
+			{
+				fields.emplace_back(make_field(battle_re, *your_hand, *enemy_hand));
+			}
+		}
+		results.resize(your_hands.size() * enemy_hands.size());
+		check_decision_cache();
 	}
 
-	inline std::vector<Results<uint64_t>> SimulationData::evaluate()
+	// sim another deck in place of your_decks[0] (see Process::evaluate_batch())
+	void SimulationData::set_your_deck(const Deck& your_deck)
 	{
-		std::vector<Results<uint64_t>> res;
-		res.reserve(enemy_hands.size()*your_hands.size());
-		for(Hand* your_hand : your_hands)
+		your_decks[0].reset(your_deck.clone());
+		your_hands[0]->deck = your_decks[0].get();
+		check_decision_cache();
+	}
+
+	// the decisions cached are kept over the runs of the same decks (every evaluate()/compare() sets them
+	// again), and dropped for other ones
+	void SimulationData::check_decision_cache()
+	{
+		if (!decision_cache.enabled())
+		{ return; }
+		std::vector<std::string> deck_hashes;
+		for (const auto& deck: your_decks) { deck_hashes.push_back(deck->hash()); }
+		for (const auto& deck: enemy_decks) { deck_hashes.push_back(deck->hash()); }
+		if (deck_hashes != decision_cache_decks)
+		{
+			decision_cache.clear();
+			decision_cache_decks.swap(deck_hashes);
+		}
+	}
+
+	// shuffle the hands of battle #battle_index (deck pair #res_index); under common random numbers the enemy
+	// shuffle, your shuffle and the battle draw from streams of their own, so that the same battle of two
+	// decks stays alike as long as the decks play alike (and the enemy draws the same cards anyway)
+	inline void SimulationData::reset_hands(RandomEngine& re, uint64_t run_seed, unsigned battle_index, unsigned res_index,
+			Hand& your_hand, Hand& enemy_hand)
+	{
+		if (!use_crn)
+		{
+			your_hand.reset(re);
+			enemy_hand.reset(re);
+			return;
+		}
+		uint64_t stream_seed = run_seed + 3 * res_index;
+		re.seed_battle(stream_seed + 1, battle_index);
+		enemy_hand.reset(re);
+		re.seed_battle(stream_seed + 2, battle_index);
+		your_hand.reset(re);
+		re.seed_battle(stream_seed + 3, battle_index);
+	}
+
+	// score of a battle (points weighted by factors like compute_score()) from its results of every deck pair
+	inline double SimulationData::battle_score(const Results<uint64_t>* battle_results) const
+	{
+		double score(0), factor_sum(0);
+		for (unsigned index(0); index < results.size(); ++index)
+		{
+			score += battle_results[index].points * factors[index];
+			factor_sum += factors[index];
+		}
+		return score / factor_sum;
+	}
+
+	inline const std::vector<Results<uint64_t>>& SimulationData::evaluate(uint64_t run_seed, unsigned battle_index)
+	{
+		battle_re.seed_battle(run_seed, battle_index);
+		unsigned res_index(0);
+		for (Hand* your_hand : your_hands)
 		{
 			for (Hand* enemy_hand: enemy_hands)
 			{
-				your_hand->reset(re);
-				enemy_hand->reset(re);
-				Field fd(re, cards, *your_hand, *enemy_hand, gamemode, optimization_mode,
-#ifndef NQUEST
-						quest,
-#endif
-						your_bg_effects, enemy_bg_effects, your_bg_skills, enemy_bg_skills,fixes, flexible_iter,flexible_turn, eval_iter,eval_turn);
+				reset_hands(battle_re, run_seed, battle_index, res_index, *your_hand, *enemy_hand);
+				Field& fd(*fields[res_index]);
+				fd.reset();
 				Results<uint64_t> result(play(&fd));
 				if (__builtin_expect(mode_open_the_deck, false))
 				{
@@ -682,137 +795,298 @@ FinalResults<long double> compute_score(const EvaluatedResults& results, std::ve
 						result.points = min_possible_score[(size_t)optimization_mode];
 					}
 				}
-				res.emplace_back(result);
+				results[res_index ++] = result;
 			}
 		}
 		//std::cout << std::endl<<  "Deck hash: " << your_hand.deck->hash() << "#"<< std::endl;
-		return(res);
+		return(results);
+	}
+
+	// add the results of battles [first_battle, first_battle + num_battles) to totals;
+	// scores (if any, by battle index) gets the score of each battle
+	void SimulationData::evaluate_range(uint64_t run_seed, unsigned first_battle, unsigned num_battles, std::vector<Results<uint64_t>>& totals, CrnRun* crn_run)
+	{
+		if (telemetry_interval > 0)
+		{ telemetry_battles.fetch_add(num_battles, std::memory_order_relaxed); }
+		for (unsigned i(first_battle); i < first_battle + num_battles; ++i)
+		{
+			const std::vector<Results<uint64_t>>& result(evaluate(run_seed, i));
+			if (crn_run)
+			{
+				crn_run->record(i, battle_score(result.data()));
+			}
+			for (unsigned index(0); index < result.size(); ++index)
+			{
+				totals[index] += result[index];
+			}
+		}
 	}
 //------------------------------------------------------------------------------
 
 //------------------------------------------------------------------------------
 //Process
 #ifdef _OPENMP
-		void Process::openmp_evaluate_reduction(EvaluatedResults & evaluated_results) {
-
-			std::vector<Results<uint64_t>> save_results(evaluated_results.first);
-			std::vector<Results<uint64_t>> results(evaluated_results.first);
-#pragma omp declare reduction \
-			(VecPlus:std::vector<Results<uint64_t>>: omp_out=merge(omp_out,omp_in))
-#pragma omp parallel default(none) shared(evaluated_results,thread_num_iterations,results)
-			{
-				SimulationData* sim = threads_data.at(omp_get_thread_num());
-				sim->set_decks(this->your_decks, this->enemy_decks);
-#pragma omp for reduction(VecPlus:results) schedule(runtime)
-				for(unsigned i =0; i < thread_num_iterations;++i) {
-					if(results.size()==0)
-						results =sim->evaluate();				//calculate single sim
-					else {
-						results =merge(results,sim->evaluate());				//calculate single sim
-					}
+		// OpenMP backend: the threads of a parallel region do the work of the boost threads (see thread_run()),
+		// keeping their totals in their SimulationData until merge_run()
+		void Process::openmp_run()
+		{
+#pragma omp parallel num_threads(this->num_threads)
+			{
+				const unsigned thread_id = omp_get_thread_num();
+				thread_run(*threads_data.at(thread_id), *this, thread_id);
+			}
+		}
+#endif
+		// every evaluate()/compare() call gets its own stream of battle seeds
+		// (but the same one under common random numbers: battle #i of every deck is the same battle)
+		uint64_t Process::next_run_seed()
+		{
+			uint64_t state = seed + (use_crn ? 0 : (static_cast<uint64_t>(num_runs++) << 32));
+			return splitmix64(state);
+		}
+
+		// record the battles that evaluated_results gets from the current run (common random numbers,
+		// not with harmonic mean: the battle scores do not add up then); nullptr if not recorded
+		CrnRun* Process::add_crn_run(const EvaluatedResults & evaluated_results, unsigned num_iterations)
+		{
+			if (!use_crn || use_harmonic_mean)
+			{ return nullptr; }
+			CrnRun& run = crn_runs[&evaluated_results];
+			run.scores.assign(num_iterations, 0);
+			run.recorded.assign(num_iterations, false);
+			run.incumbent_scores = &crn_incumbent_scores;
+			run.incumbent_recorded = &crn_incumbent_recorded;
+			return &run;
+		}
+
+		// the deck of evaluated_results becomes the incumbent that the next comparisons are paired with
+		// (nullptr: no pairing): it keeps the battles recorded by the latest run (and the ones recorded
+		// before if it already was the incumbent)
+		void Process::set_crn_incumbent(const EvaluatedResults * evaluated_results)
+		{
+			if (evaluated_results != crn_incumbent)
+			{
+				crn_incumbent = evaluated_results;
+				crn_incumbent_scores.clear();
+				crn_incumbent_recorded.clear();
+			}
+			if (!crn_incumbent)
+			{ return; }
+			crn_incumbent_scores.resize(crn_incumbent->second, 0);
+			crn_incumbent_recorded.resize(crn_incumbent->second, false);
+			auto run = crn_runs.find(crn_incumbent);
+			if (run == crn_runs.end())
+			{ return; }
+			const CrnRun& recorded_run(run->second);
+			for (unsigned i(0); i < std::min(recorded_run.scores.size(), crn_incumbent_scores.size()); ++i)
+			{
+				if (recorded_run.recorded[i])
+				{
+					crn_incumbent_scores[i] = recorded_run.scores[i];
+					crn_incumbent_recorded[i] = true;
 				}
-#pragma omp for schedule(runtime)
-				for( unsigned i =0; i< results.size();++i)
-					evaluated_results.first[i] =results[i]; //+?
-
-			}
-			evaluated_results.second+=thread_num_iterations;
-		}
-
-		void Process::openmp_compare_reduction(EvaluatedResults & evaluated_results) {
-
-			const unsigned c_num_threads = opt_num_threads;
-			std::vector<Results<uint64_t>> save_results(evaluated_results.first);
-			std::vector<Results<uint64_t>> results(evaluated_results.first);
-			bool compare_stop{false};
-			unsigned trials[c_num_threads] = {0};
-			long double successes [c_num_threads] = {.0};
-			const long double max_possible =  max_possible_score[(size_t)optimization_mode];
-			const long double prob =1-confidence_level;
-			omp_lock_t locks[c_num_threads];
-			for(unsigned  i =0; i < c_num_threads;++i)
-				omp_init_lock(&locks[i]);
-#pragma omp declare reduction \
-			(VecPlus:std::vector<Results<uint64_t>>: omp_out=merge(omp_out,omp_in))
-#pragma omp parallel default(none) shared(evaluated_results,trials,successes,locks, compare_stop, thread_num_iterations,results, \
-		thread_best_results, min_increment_of_score)
-			{
-				SimulationData* sim = threads_data.at(omp_get_thread_num());
-				sim->set_decks(this->your_decks, this->enemy_decks);
-				const long double sim_accum = std::accumulate(sim->factors.begin(), sim->factors.end(),.0);
-#pragma omp for reduction(VecPlus:results) schedule(runtime)
-				for(unsigned i =0; i < thread_num_iterations;++i) {
-#pragma omp cancellation point for
-					if(!compare_stop){
-						if(results.size()==0)
-							results =sim->evaluate();				//calculate single sim
-						else
-							results =merge(results,sim->evaluate());				//calculate single sim
-						long double score_accum_d = 0.0;
-						for(unsigned j=0; j < results.size(); ++j)
-							score_accum_d+=results[j].points * sim->factors[j];
-						score_accum_d /= sim_accum*max_possible;
-						omp_set_lock(&locks[omp_get_thread_num()]);
-						trials[omp_get_thread_num()]++;
-						successes[omp_get_thread_num()] = score_accum_d;
-						omp_unset_lock(&locks[omp_get_thread_num()]);
-						//#pragma omp master
-						if(omp_get_thread_num()==0)
-						{
+			}
+		}
 
-							unsigned ttrials = 0;
-							long double ssuccesses =0.0;
-							for(unsigned  l= 0; l < c_num_threads;++l)
-							{
-								omp_set_lock(&locks[l]);
-								ttrials += trials[l];
-								ssuccesses += successes[l];
-								omp_unset_lock(&locks[l]);
-							}
-							if(ssuccesses > ttrials)
-							{
-								ssuccesses = ttrials;
-								printf("WARNING: biominal successes {%Le} > trials {%d} in Threads\n", ssuccesses,ttrials);
-								//_DEBUG_MSG(2,"WARNING: biominal successes > trials in Threads");
-							}
-							compare_stop = (boost::math::binomial_distribution<>::find_upper_bound_on_p(ttrials, ssuccesses, prob) * max_possible <
-									thread_best_results->points + min_increment_of_score);
-							if(compare_stop)
-							{
-#pragma omp cancel for
-							}
+		// score of the incumbent over the first num_battles battles (those that a deck simmed num_battles
+		// times is paired with), or points (its score over all its battles) if they are not all recorded
+		long double Process::crn_incumbent_points(unsigned num_battles, long double points) const
+		{
+			if (!crn_incumbent || (num_battles == 0) || (num_battles >= crn_incumbent->second)
+					|| (num_battles > crn_incumbent_scores.size()))
+			{ return points; }
+			long double sum(0);
+			for (unsigned i(0); i < num_battles; ++i)
+			{
+				if (!crn_incumbent_recorded[i])
+				{ return points; }
+				sum += crn_incumbent_scores[i];
+			}
+			return sum / num_battles;
+		}
+
+		void Process::print_decision_stats() const
+		{
+			uint64_t hits(0), misses(0), decisions(0), rollouts(0);
+			for (auto sim: threads_data)
+			{
+				hits += sim->decision_cache.hits;
+				misses += sim->decision_cache.misses;
+				decisions += sim->decision_cache.decisions;
+				rollouts += sim->decision_cache.rollouts;
+			}
+			if (decisions > 0)
+			{
+				std::cout << "Rollouts per decision: " << (static_cast<double>(rollouts) / decisions)
+					<< " (" << decisions << " decisions)" << std::endl;
+			}
+			if (hits + misses > 0)
+			{
+				std::cout << "Decision cache: " << hits << " hits, " << misses << " misses ("
+					<< (100.0 * hits / (hits + misses)) << "% hit rate)" << std::endl;
+			}
+		}
+
+		void Process::count_compare(unsigned num_iterations, const EvaluatedResults & evaluated_results)
+		{
+			if (sprt_alpha > 0 && evaluated_results.second < num_iterations)
+			{
+				sprt_skipped_simulations += num_iterations - evaluated_results.second;
+			}
+			if (telemetry)
+			{
+				++ telemetry->compares;
+				if (evaluated_results.second < num_iterations)
+				{ ++ telemetry->early_stops; }
+				telemetry->compare_sims += evaluated_results.second;
+			}
+		}
+
+		unsigned long Process::take_sprt_skipped_simulations()
+		{
+			unsigned long skipped_simulations = sprt_skipped_simulations;
+			sprt_skipped_simulations = 0;
+			return skipped_simulations;
+		}
 
+		void Process::start_telemetry()
+		{
+			telemetry.reset(new Telemetry);
+			telemetry->start = telemetry->last_time = std::chrono::steady_clock::now();
+			telemetry->out = &std::cerr;
+			if (!telemetry_file.empty())
+			{
+				telemetry->file.open(telemetry_file, std::ios::app);
+				if (telemetry->file)
+				{ telemetry->out = &telemetry->file; }
+				else
+				{ std::cerr << "WARNING: telemetry: cannot open " << telemetry_file << ", writing to stderr" << std::endl; }
+			}
+			telemetry->last_battles.assign(threads_data.size(), 0);
+			telemetry->last_wait_ns.assign(threads_data.size(), 0);
+			telemetry->thread = new boost::thread([this]() {
+					try
+					{
+						while (true)
+						{
+							boost::this_thread::sleep(boost::posix_time::seconds(telemetry_interval));
+							report_telemetry();
 						}
 					}
-				}
-#pragma omp for schedule(runtime)
-				for( unsigned i =0; i< results.size();++i)
-					evaluated_results.first[i] =results[i]; //+?
-			}
-			evaluated_results.second+=thread_num_iterations;
-			for(unsigned i =0; i < c_num_threads;++i)
-				omp_destroy_lock(&locks[i]);
+					catch (boost::thread_interrupted&) {}
+				});
 		}
 
+		void Process::stop_telemetry()
+		{
+			if (!telemetry)
+			{ return; }
+			telemetry->thread->interrupt();
+			telemetry->thread->join();
+			delete(telemetry->thread);
+			report_telemetry();
+			telemetry.reset();
+		}
 
-		std::vector<Results<uint64_t>> merge(std::vector<Results<uint64_t>> out, std::vector<Results<uint64_t>> in)
+		// one line of JSON: battles per second (since the previous report) and barrier wait of every
+		// thread, then the totals since the start: comparisons and evaluated decks
+		void Process::report_telemetry()
+		{
+			Telemetry& t(*telemetry);
+			auto now = std::chrono::steady_clock::now();
+			double elapsed = std::chrono::duration<double>(now - t.last_time).count();
+			std::ostringstream json;
+			json << "{\"time\":" << std::chrono::duration<double>(now - t.start).count() << ",\"threads\":[";
+			double battles_per_second(0);
+			for (unsigned thread_id(0); thread_id < threads_data.size(); ++thread_id)
+			{
+				uint64_t battles = threads_data[thread_id]->telemetry_battles.load(std::memory_order_relaxed);
+				uint64_t wait_ns = threads_data[thread_id]->telemetry_wait_ns.load(std::memory_order_relaxed);
+				double thread_battles_per_second = elapsed > 0 ? (battles - t.last_battles[thread_id]) / elapsed : 0;
+				battles_per_second += thread_battles_per_second;
+				json << (thread_id ? "," : "") << "{\"battles_per_second\":" << thread_battles_per_second
+					<< ",\"barrier_wait_s\":" << (wait_ns - t.last_wait_ns[thread_id]) * 1e-9 << "}";
+				t.last_battles[thread_id] = battles;
+				t.last_wait_ns[thread_id] = wait_ns;
+			}
+			uint64_t compares(t.compares), lookups(t.deck_lookups);
+			json << "],\"battles_per_second\":" << battles_per_second
+				<< ",\"compares\":" << compares
+				<< ",\"early_stop_rate\":" << (compares ? static_cast<double>(t.early_stops) / compares : 0)
+				<< ",\"sims_per_candidate\":" << (compares ? static_cast<double>(t.compare_sims) / compares : 0)
+				<< ",\"evaluated_decks\":{\"lookups\":" << lookups
+				<< ",\"hit_rate\":" << (lookups ? static_cast<double>(t.deck_hits) / lookups : 0)
+				<< ",\"entries\":" << t.deck_entries
+				<< ",\"bytes\":" << t.deck_bytes << "}}\n";
+			*t.out << json.str() << std::flush;
+			t.last_time = now;
+		}
+
+		// battles claimed at once: ~8 chunks per thread (balance) but not too large (early stop of compare() reacts
+		// per chunk); in deterministic mode the chunks are the early stop checkpoints: they do not depend on the threads
+		unsigned Process::run_chunk_size(unsigned num_battles) const
+		{
+			return std::max(1u, std::min(64u, num_battles / (use_deterministic ? 64 : 8 * num_threads)));
+		}
+
+		// set up a run of battles [evaluated_results.second, num_iterations): threads claim
+		// chunks of it with an atomic counter and keep their own totals until merge_run()
+		void Process::start_run(unsigned num_iterations, EvaluatedResults & evaluated_results)
 		{
-			//printf("merging out: %d in: %d \n", (int)out[0].wins, (int)in[0].wins);
-			//printf("out%p ",(void *)&out );
-			for( unsigned i =0; i< out.size();++i)
-				out[i] +=in[i];
-			//printf("merged out: %d \n", (int)out[0].wins);
-			return out;
+			thread_num_iterations = num_iterations - evaluated_results.second;
+			thread_results = &evaluated_results;
+			thread_run_seed = next_run_seed();
+			thread_next_battle = evaluated_results.second;
+			thread_claimed_battles = 0;
+			crn_runs.clear();
+			thread_crn_run = add_crn_run(evaluated_results, num_iterations);
+			thread_chunk_size = run_chunk_size(thread_num_iterations);
+			for (auto sim: threads_data)
+			{
+				std::fill(sim->run_results.begin(), sim->run_results.end(), Results<uint64_t>());
+				sim->run_battles = 0;
+				for (auto& points: sim->run_published_points) { points = 0; }
+				sim->run_published_battles = 0;
+				sim->run_pairs = PairedSums();
+				sim->run_published_pairs = 0;
+				sim->run_published_pair_sum = 0;
+				sim->run_published_pair_sq_sum = 0;
+			}
 		}
-#endif
+
+		void Process::merge_run(EvaluatedResults & evaluated_results)
+		{
+			if (thread_ordered)
+			{
+				// deterministic mode: the battles up to the early stop only (see OrderedReduction)
+				thread_ordered->reduce([&](const std::vector<Results<uint64_t>>& run_results, unsigned run_battles, const PairedSums& run_pairs) {
+						return compare_can_stop(evaluated_results, run_results, run_battles, run_pairs, factors, *thread_best_results);
+					}, true);
+				for (unsigned index(0); index < evaluated_results.first.size(); ++index)
+				{
+					evaluated_results.first[index] += thread_ordered->results[index];
+				}
+				evaluated_results.second += thread_ordered->battles;
+				thread_ordered = nullptr;
+				return;
+			}
+			for (auto sim: threads_data)
+			{
+				for (unsigned index(0); index < sim->run_results.size(); ++index)
+				{
+					evaluated_results.first[index] += sim->run_results[index];
+				}
+				evaluated_results.second += sim->run_battles;
+			}
+		}
+
 		EvaluatedResults & Process::evaluate(unsigned num_iterations, EvaluatedResults & evaluated_results)
 		{
 			if (num_iterations <= evaluated_results.second)
 			{
 				return evaluated_results;
 			}
-			thread_num_iterations = num_iterations - evaluated_results.second;
-			thread_results = &evaluated_results;
+			start_run(num_iterations, evaluated_results);
 			thread_compare = false;
 #ifndef _OPENMP
 			// unlock all the threads
@@ -820,8 +1094,9 @@ FinalResults<long double> compute_score(const EvaluatedResults& results, std::ve
 			// wait for the threads
 			main_barrier.wait();
 #else
-			openmp_evaluate_reduction(evaluated_results);
+			openmp_run();
 #endif
+			merge_run(evaluated_results);
 			return evaluated_results;
 		}
 
@@ -831,106 +1106,470 @@ FinalResults<long double> compute_score(const EvaluatedResults& results, std::ve
 			{
 				return evaluated_results;
 			}
-			thread_num_iterations = num_iterations - evaluated_results.second;
-			thread_results = &evaluated_results;
+			start_run(num_iterations, evaluated_results);
 			thread_best_results = &best_results;
 			thread_compare = true;
 			thread_compare_stop = false;
+			if (use_deterministic)
+			{
+				ordered_run.reset((thread_num_iterations + thread_chunk_size - 1) / thread_chunk_size, evaluated_results.first.size());
+				thread_ordered = &ordered_run;
+			}
 #ifndef _OPENMP
 			// unlock all the threads
 			main_barrier.wait();
 			// wait for the threads
 			main_barrier.wait();
 #else
-			openmp_compare_reduction(evaluated_results);
+			openmp_run();
 #endif
+			merge_run(evaluated_results);
+			count_compare(num_iterations, evaluated_results);
 			return evaluated_results;
 		}
+
+		// evaluate several decks at once: the threads interleave the battles of all the candidates,
+		// so that one finishing (or stopping early) does not leave the others waiting at the barrier;
+		// every candidate gets its own run seed (as if evaluate()/compare() were called in turn).
+		// The persistent threads are the work pool: each starts at a candidate of its own and takes
+		// chunks of the others' battles once it is done (see thread_evaluate_batch()).
+		// Used by genetic (pool and bred decks), beam (pool) and the speculative moves of climb/beam.
+		// Speculative moves pass accepted(candidate index): only the first accepted candidate is kept,
+		// so once one has its final results (all its battles merged) and is accepted, the candidates
+		// after it are stopped, keeping the battles simmed so far. Not in the deterministic mode,
+		// where the battles of a candidate must not depend on the timing of the others.
+		void Process::evaluate_batch(const std::vector<BatchCandidate> & candidates, unsigned num_iterations,
+				const std::function<bool(unsigned)> & accepted)
+		{
+			// a candidate simmed enough already and accepted leaves nothing to sim after it
+			unsigned num_candidates(0), num_runs(0);
+			for (const BatchCandidate& candidate: candidates)
+			{
+				++ num_candidates;
+				if (num_iterations > candidate.results->second)
+				{ ++ num_runs; }
+				else if (accepted && accepted(num_candidates - 1))
+				{ break; }
+			}
+			if (num_runs == 0)
+			{ return; }
+			std::vector<BatchRun> runs(num_runs);
+			auto run = runs.begin();
+			crn_runs.clear();
+			for (unsigned index(0); index < num_candidates; ++index)
+			{
+				const BatchCandidate& candidate(candidates[index]);
+				if (num_iterations <= candidate.results->second)
+				{ continue; }
+				run->candidate = &candidate;
+				run->candidate_index = index;
+				run->run_seed = next_run_seed();
+				run->first_battle = candidate.results->second;
+				run->num_battles = num_iterations - candidate.results->second;
+				run->chunk_size = run_chunk_size(run->num_battles);
+				run->claimed_battles = 0;
+				run->stop = false;
+				run->crn_run = add_crn_run(*candidate.results, num_iterations);
+				run->pairs = PairedSums();
+				run->ordered = use_deterministic && candidate.best_results;
+				if (run->ordered)
+				{ run->ordered_results.reset((run->num_battles + run->chunk_size - 1) / run->chunk_size, candidate.results->first.size()); }
+				++ run;
+			}
+			thread_batch_runs = &runs;
+			thread_batch_accepted = (accepted && !use_deterministic) ? &accepted : nullptr;
+#ifndef _OPENMP
+			// unlock all the threads
+			main_barrier.wait();
+			// wait for the threads
+			main_barrier.wait();
+#else
+			openmp_run();
+#endif
+			thread_batch_runs = nullptr;
+			thread_batch_accepted = nullptr;
+			for (BatchRun& run: runs)
+			{
+				EvaluatedResults& results(*run.candidate->results);
+				if (run.ordered)
+				{
+					// deterministic mode: the battles up to the early stop only (see OrderedReduction)
+					run.ordered_results.reduce([&](const std::vector<Results<uint64_t>>& run_results, unsigned run_battles, const PairedSums& run_pairs) {
+							return compare_can_stop(results, run_results, run_battles, run_pairs, factors, *run.candidate->best_results);
+						}, true);
+					for (unsigned index(0); index < results.first.size(); ++index)
+					{
+						results.first[index] += run.ordered_results.results[index];
+					}
+					results.second += run.ordered_results.battles;
+				}
+				if (run.candidate->best_results)
+				{ count_compare(num_iterations, results); }
+			}
+		}
 //------------------------------------------------------------------------------
-void thread_evaluate(boost::barrier& main_barrier,
-		boost::mutex& shared_mutex,
-		SimulationData& sim,
-		const Process& p,
-		unsigned thread_id)
+// Wald's sequential probability ratio test on the log-likelihood ratio of H1 against H0
+// (sprt_alpha: false accept rate, sprt_beta: false reject rate); true once either hypothesis is accepted
+bool sprt_decided(long double llr)
 {
-#ifndef _OPENMP
-	while (true)
+	return (llr >= std::log((1 - sprt_beta) / sprt_alpha)) || (llr <= std::log(sprt_beta / (1 - sprt_alpha)));
+}
+
+// binomial SPRT: H0 p = target - sprt_delta against H1 p = target + sprt_delta
+bool sprt_decided(unsigned trials, long double successes, long double target)
+{
+	if (target >= 1)
+	{ return true; } // nothing can beat it
+	long double p0 = std::max<long double>(target - sprt_delta, 1e-6);
+	long double p1 = std::min<long double>(std::max<long double>(target + sprt_delta, 2e-6), 1 - 1e-6);
+	return sprt_decided(successes * std::log(p1 / p0) + (trials - successes) * std::log((1 - p1) / (1 - p0)));
+}
+
+// compare() early stop on the merged counts (successes: the score scaled to [0, trials]): no chance
+// to beat best_results (binomial upper bound) or, with sprt, the sequential test has decided either way
+bool compare_can_stop(unsigned trials, long double successes, const volatile FinalResults<long double>& best_results)
+{
+	long double max_possible = max_possible_score[(size_t)optimization_mode];
+	if (sprt_alpha > 0)
 	{
-		main_barrier.wait();
-		sim.set_decks(p.your_decks, p.enemy_decks);
-		if (destroy_threads)
-		{ return; }
-		while (true)
+		return sprt_decided(trials, successes, (best_results.points + min_increment_of_score) / max_possible);
+	}
+	auto prob = 1-confidence_level;
+	// Get a loose (better than no) upper bound. TODO: Improve it.
+	return clopper_pearson_upper_below(trials, successes, prob, (best_results.points + min_increment_of_score) / max_possible);
+}
+
+bool compare_can_stop(const std::vector<uint64_t>& points, unsigned trials, const std::vector<long double>& factors,
+		const volatile FinalResults<long double>& best_results)
+{
+	unsigned score_accum = 0;
+	// Multiple defense decks case: scaling by factors and approximation of a "discrete" number of events.
+	if (points.size() > 1)
+	{
+		long double score_accum_d = 0.0;
+		for (unsigned i = 0; i < points.size(); ++i)
+		{
+			score_accum_d += points[i] * factors[i];
+		}
+		score_accum_d /= std::accumulate(factors.begin(), factors.end(), .0);
+		score_accum = score_accum_d;
+	}
+	else
+	{
+		score_accum = points[0];
+	}
+	long double max_possible = max_possible_score[(size_t)optimization_mode];
+
+	//APN
+	auto successes = score_accum / max_possible;
+	if(successes > trials)
+	{
+		successes = trials;
+		printf("WARNING: biominal successes > trials in Threads");
+		_DEBUG_MSG(2,"WARNING: biominal successes > trials in Threads");
+	}
+	return compare_can_stop(trials, successes, best_results);
+}
+
+// compare() early stop on the paired differences (deck - incumbent) of the battles both have played under
+// common random numbers: their mean cannot exceed min_increment_of_score (normal upper bound) or, with sprt,
+// a sequential test (normal, variance estimated, indifference zone of +-sprt_delta) has decided either way
+bool compare_can_stop(const PairedSums& pairs)
+{
+	// the variance estimate needs some battles (the same battle of two decks often ends alike)
+	if (pairs.pairs < 30)
+	{ return false; }
+	long double n = pairs.pairs;
+	long double mean = pairs.sum / n;
+	long double variance = std::max<long double>((pairs.sq_sum - pairs.sum * mean) / (n - 1), 1e-9);
+	if (sprt_alpha > 0)
+	{
+		long double delta = sprt_delta * max_possible_score[(size_t)optimization_mode];
+		return sprt_decided(2 * delta / variance * (pairs.sum - n * min_increment_of_score));
+	}
+	auto prob = 1-confidence_level;
+	return (mean + normal_upper_quantile(prob) * std::sqrt(variance / n) < min_increment_of_score);
+}
+
+// compare() early stop on the results before a run plus the battles of the run so far (paired when possible)
+bool compare_can_stop(const EvaluatedResults& results, const std::vector<Results<uint64_t>>& run_results, unsigned run_battles,
+		const PairedSums& run_pairs, const std::vector<long double>& factors, const volatile FinalResults<long double>& best_results)
+{
+	if (run_pairs.pairs > 0)
+	{ return compare_can_stop(run_pairs); }
+	const unsigned trials(results.second + run_battles);
+	if (trials <= 1)
+	{ return false; }
+	thread_local std::vector<uint64_t> points;
+	points.resize(results.first.size());
+	for (unsigned index(0); index < points.size(); ++index)
+	{
+		points[index] = results.first[index].points + run_results[index].points;
+	}
+	return compare_can_stop(points, trials, factors, best_results);
+}
+
+// evaluate_batch() share of a thread: go round the candidates (each thread starting at its own one)
+// claiming a chunk of battles at a time, until a whole round finds nothing left to claim
+void thread_evaluate_batch(SimulationData& sim, std::vector<BatchRun>& runs, unsigned thread_id)
+{
+	std::vector<uint64_t> points;
+	const BatchRun* loaded_run(nullptr);
+	const unsigned num_runs(runs.size());
+	for (unsigned index(thread_id % num_runs), num_idle(0); num_idle < num_runs; index = (index + 1) % num_runs)
+	{
+		BatchRun& run(runs[index]);
+		unsigned first = run.stop.load(std::memory_order_relaxed) ? run.num_battles
+			: run.claimed_battles.fetch_add(run.chunk_size, std::memory_order_relaxed);
+		if (first >= run.num_battles)
 		{
-			shared_mutex.lock(); //<<<<
-			if (thread_num_iterations == 0 || (thread_compare && thread_compare_stop)) //!
+			++ num_idle;
+			continue;
+		}
+		num_idle = 0;
+		if (loaded_run != &run)
+		{
+			sim.set_your_deck(*run.candidate->deck);
+			loaded_run = &run;
+		}
+		unsigned last = std::min(first + run.chunk_size, run.num_battles);
+		std::fill(sim.run_results.begin(), sim.run_results.end(), Results<uint64_t>());
+		sim.evaluate_range(run.run_seed, run.first_battle + first, last - first, sim.run_results,
+				run.crn_run);
+		PairedSums pairs{0, 0, 0};
+		if (run.crn_run)
+		{ run.crn_run->add_pairs(run.first_battle + first, run.first_battle + last, pairs); }
+		if (run.ordered)
+		{
+			// deterministic mode: reduced in battle order, merged once the batch is over (see OrderedReduction)
+			run.ordered_results.put(first / run.chunk_size, sim.run_results, last - first, pairs);
+			const EvaluatedResults& results(*run.candidate->results);
+			if (run.ordered_results.reduce([&](const std::vector<Results<uint64_t>>& run_results, unsigned run_battles, const PairedSums& run_pairs) {
+					return compare_can_stop(results, run_results, run_battles, run_pairs, sim.factors, *run.candidate->best_results);
+				}, false))
 			{
-				shared_mutex.unlock(); //>>>>
-				main_barrier.wait();
-				break;
+				run.stop = true;
 			}
-			else
+			continue;
+		}
+		run.mutex.lock(); //<<<<
+		EvaluatedResults& results(*run.candidate->results);
+		for (unsigned i(0); i < results.first.size(); ++i)
+		{
+			results.first[i] += sim.run_results[i];
+		}
+		results.second += last - first;
+		run.pairs.pairs += pairs.pairs;
+		run.pairs.sum += pairs.sum;
+		run.pairs.sq_sum += pairs.sq_sum;
+		if (run.candidate->best_results && (run.pairs.pairs > 0))
+		{
+			// paired with the incumbent (common random numbers)
+			if (compare_can_stop(run.pairs))
 			{
-				--thread_num_iterations; //!
-				shared_mutex.unlock(); //>>>>
-				std::vector<Results<uint64_t>> result{sim.evaluate()};
-				shared_mutex.lock(); //<<<<
-				std::vector<uint64_t> thread_score_local(thread_results->first.size(), 0u); //!
-				for (unsigned index(0); index < result.size(); ++index)
+				run.stop = true;
+			}
+		}
+		else if (run.candidate->best_results && (results.second > 1))
+		{
+			points.resize(results.first.size());
+			for (unsigned i(0); i < points.size(); ++i)
+			{
+				points[i] = results.first[i].points;
+			}
+			if (compare_can_stop(points, results.second, sim.factors, *run.candidate->best_results))
+			{
+				run.stop = true;
+			}
+		}
+		// all the battles merged: the final results (see Process::evaluate_batch())
+		bool accepted = thread_batch_accepted && (results.second == run.first_battle + run.num_battles)
+			&& (*thread_batch_accepted)(run.candidate_index);
+		run.mutex.unlock(); //>>>>
+		if (accepted)
+		{
+			for (BatchRun& later_run: runs)
+			{
+				if (later_run.candidate_index > run.candidate_index)
+				{ later_run.stop = true; }
+			}
+		}
+	}
+}
+
+// a thread's share of the current run (boost threads and OpenMP alike): claim chunks of battles
+// until there are none left (or compare() can stop), adding them up in sim.run_results
+void thread_run(SimulationData& sim, const Process& p, unsigned thread_id)
+{
+	thread_local std::vector<uint64_t> thread_score_local;
+	sim.set_decks(p.your_decks, p.enemy_decks);
+	if (thread_batch_runs)
+	{
+		thread_evaluate_batch(sim, *thread_batch_runs, thread_id);
+		return;
+	}
+	const unsigned num_iterations = thread_num_iterations;
+	const unsigned chunk_size = thread_chunk_size;
+	CrnRun* const crn_run = thread_crn_run;
+	OrderedReduction* const ordered = thread_ordered;
+	while (!(thread_compare && thread_compare_stop))
+	{
+		// claim the next chunk of battles (no lock)
+		unsigned first = thread_claimed_battles.fetch_add(chunk_size, std::memory_order_relaxed);
+		if (first >= num_iterations)
+		{ break; }
+		unsigned last = std::min(first + chunk_size, num_iterations);
+		if (ordered)
+		{
+			// deterministic mode: the chunk is reduced in battle order (see OrderedReduction)
+			std::fill(sim.run_results.begin(), sim.run_results.end(), Results<uint64_t>());
+			sim.evaluate_range(thread_run_seed, thread_next_battle + first, last - first, sim.run_results,
+					crn_run);
+			PairedSums pairs{0, 0, 0};
+			if (crn_run)
+			{ crn_run->add_pairs(thread_next_battle + first, thread_next_battle + last, pairs); }
+			ordered->put(first / chunk_size, sim.run_results, last - first, pairs);
+			if (ordered->reduce([&sim](const std::vector<Results<uint64_t>>& run_results, unsigned run_battles, const PairedSums& run_pairs) {
+					return compare_can_stop(*thread_results, run_results, run_battles, run_pairs, sim.factors, *thread_best_results);
+				}, false))
+			{
+				thread_compare_stop = true;
+			}
+			continue;
+		}
+		sim.evaluate_range(thread_run_seed, thread_next_battle + first, last - first, sim.run_results,
+				crn_run);
+		sim.run_battles += last - first;
+		if (!thread_compare)
+		{ continue; }
+		for (unsigned index(0); index < sim.run_results.size(); ++index)
+		{
+			sim.run_published_points[index].store(sim.run_results[index].points, std::memory_order_relaxed);
+		}
+		sim.run_published_battles.store(sim.run_battles, std::memory_order_release);
+		if (crn_run)
+		{
+			crn_run->add_pairs(thread_next_battle + first, thread_next_battle + last, sim.run_pairs);
+			sim.run_published_pair_sum.store(sim.run_pairs.sum, std::memory_order_relaxed);
+			sim.run_published_pair_sq_sum.store(sim.run_pairs.sq_sum, std::memory_order_relaxed);
+			sim.run_published_pairs.store(sim.run_pairs.pairs, std::memory_order_release);
+		}
+		if (thread_id == 0 && crn_run)
+		{
+			// paired with the incumbent (common random numbers) once it has played some of these battles
+			PairedSums pairs{0, 0, 0};
+			for (auto other: p.threads_data)
+			{
+				pairs.pairs += other->run_published_pairs.load(std::memory_order_acquire);
+				pairs.sum += other->run_published_pair_sum.load(std::memory_order_relaxed);
+				pairs.sq_sum += other->run_published_pair_sq_sum.load(std::memory_order_relaxed);
+			}
+			if (pairs.pairs > 0)
+			{
+				if (compare_can_stop(pairs))
 				{
-					thread_results->first[index] += result[index]; //!
-					thread_score_local[index] = thread_results->first[index].points; //!
+					thread_compare_stop = true; //!
 				}
-				++thread_results->second; //!
-				unsigned thread_total_local{thread_results->second}; //!
-				shared_mutex.unlock(); //>>>>
-				if (thread_compare && thread_id == 0 && thread_total_local > 1)
+				continue;
+			}
+		}
+		if (thread_id == 0)
+		{
+			// totals so far: results before this run + what every thread has published
+			unsigned thread_total_local{thread_results->second};
+			thread_score_local.resize(thread_results->first.size());
+			for (unsigned index(0); index < thread_score_local.size(); ++index)
+			{
+				thread_score_local[index] = thread_results->first[index].points;
+			}
+			for (auto other: p.threads_data)
+			{
+				thread_total_local += other->run_published_battles.load(std::memory_order_acquire);
+				for (unsigned index(0); index < thread_score_local.size(); ++index)
 				{
-					unsigned score_accum = 0;
-					// Multiple defense decks case: scaling by factors and approximation of a "discrete" number of events.
-					if (result.size() > 1)
-					{
-						long double score_accum_d = 0.0;
-						for (unsigned i = 0; i < thread_score_local.size(); ++i)
-						{
-							score_accum_d += thread_score_local[i] * sim.factors[i];
-						}
-						score_accum_d /= std::accumulate(sim.factors.begin(), sim.factors.end(), .0);
-						score_accum = score_accum_d;
-					}
-					else
-					{
-						score_accum = thread_score_local[0];
-					}
-					bool compare_stop(false);
-					long double max_possible = max_possible_score[(size_t)optimization_mode];
-
-					//APN
-					auto trials = thread_total_local;
-					auto prob = 1-confidence_level;
-					auto successes = score_accum / max_possible;
-					if(successes > trials)
-					{
-						successes = trials;
-						printf("WARNING: biominal successes > trials in Threads");
-						_DEBUG_MSG(2,"WARNING: biominal successes > trials in Threads");
-					}
-
-
-					// Get a loose (better than no) upper bound. TODO: Improve it.
-					compare_stop = (boost::math::binomial_distribution<>::find_upper_bound_on_p(trials, successes, prob) * max_possible <
-							thread_best_results->points + min_increment_of_score);
-					if (compare_stop)
-					{
-						shared_mutex.lock(); //<<<<
-						//std::cout << thread_total_local << "\n";
-						thread_compare_stop = true; //!
-						shared_mutex.unlock(); //>>>>
-					}
+					thread_score_local[index] += other->run_published_points[index].load(std::memory_order_relaxed);
 				}
 			}
+			if (thread_total_local <= 1)
+			{ continue; }
+			if (compare_can_stop(thread_score_local, thread_total_local, sim.factors, *thread_best_results))
+			{
+				thread_compare_stop = true; //!
+			}
+		}
+	}
+}
+
+void thread_evaluate(boost::barrier& main_barrier,
+		SimulationData& sim,
+		const Process& p,
+		unsigned thread_id)
+{
+#ifndef _OPENMP
+	// time spent at the barriers (telemetry): waiting for a run, and for the other threads to finish it
+	auto barrier_wait = [&main_barrier, &sim]() {
+		if (telemetry_interval == 0)
+		{
+			main_barrier.wait();
+			return;
+		}
+		auto start = std::chrono::steady_clock::now();
+		main_barrier.wait();
+		sim.telemetry_wait_ns.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+				std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+	};
+	while (true)
+	{
+		barrier_wait();
+		if (destroy_threads)
+		{ return; }
+		thread_run(sim, p, thread_id);
+		barrier_wait();
+	}
+#endif
+}
+
+// pin the worker threads, one per cpu, to the cpus this process may run on (opt-in: the scheduler
+// does as well on most machines). Not done when there are more threads than cpus: sharing a pinned cpu
+// is slower than letting the threads migrate. The cards and decks are not copied per NUMA node: the
+// threads of every node read the ones loaded by the main thread (see TODO).
+void pin_threads(const std::vector<boost::thread*>& threads)
+{
+#if defined(__linux__)
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+	{
+		std::cerr << "WARNING: affinity: cannot get the cpus of the process, threads are not pinned" << std::endl;
+		return;
+	}
+	std::vector<unsigned> cpus;
+	for (unsigned cpu(0); cpu < CPU_SETSIZE; ++cpu)
+	{
+		if (CPU_ISSET(cpu, &allowed))
+		{ cpus.push_back(cpu); }
+	}
+	if (threads.size() > cpus.size())
+	{
+		std::cerr << "WARNING: affinity: " << threads.size() << " threads for " << cpus.size() << " cpus, threads are not pinned" << std::endl;
+		return;
+	}
+	std::cout << "Thread placement:";
+	for (unsigned thread_id(0); thread_id < threads.size(); ++thread_id)
+	{
+		cpu_set_t thread_cpus;
+		CPU_ZERO(&thread_cpus);
+		CPU_SET(cpus[thread_id], &thread_cpus);
+		if (pthread_setaffinity_np(threads[thread_id]->native_handle(), sizeof(thread_cpus), &thread_cpus) != 0)
+		{
+			std::cout << " " << thread_id << ":not pinned";
+			continue;
 		}
+		std::cout << " " << thread_id << ":cpu" << cpus[thread_id];
 	}
+	std::cout << std::endl;
+#else
+	std::cerr << "WARNING: affinity is only supported on Linux, threads are not pinned" << std::endl;
 #endif
 }
 //------------------------------------------------------------------------------
@@ -1303,7 +1942,7 @@ if (deck->alpha_dominion)
 { std::cout << ", " << deck->alpha_dominion->m_name; }
 
 // print deck cards
-if (deck->strategy == DeckStrategy::random || deck->strategy == DeckStrategy::flexible || deck->strategy == DeckStrategy::evaluate|| deck->strategy == DeckStrategy::evaluate_twice)
+if (deck->strategy == DeckStrategy::random || deck->strategy == DeckStrategy::flexible || deck->strategy == DeckStrategy::flexible_adaptive || deck->strategy == DeckStrategy::evaluate|| deck->strategy == DeckStrategy::evaluate_twice)
 {
 	std::sort(deck->cards.begin(), deck->cards.end(), [](const Card* a, const Card* b) { return a->m_id < b->m_id; });
 }
@@ -1516,6 +2155,9 @@ void usage(int argc, char** argv)
 {
 	std::cout << "Tyrant Unleashed Optimizer (TUO) " << TYRANT_OPTIMIZER_VERSION << "\n"
 		"usage: " << argv[0] << " Your_Deck Enemy_Deck [Flags] [Operations]\n"
+		"       " << argv[0] << " daemon [socket <path>] [prefix <dir>] [_<suffix> ...] [no-cards-cache]\n"
+		"         (load the data once, then run the requests \"Your_Deck Enemy_Deck [Flags] [Operations]\" read line by line\n"
+		"         from stdin or the Unix socket <path>, with their output as lines of JSON; \"quit\" stops it)\n"
 		"\n"
 		"Your_Deck:\n"
 		"  the name/hash/cards of a custom deck.\n"
@@ -1531,6 +2173,13 @@ void usage(int argc, char** argv)
 		"  -r: the attack deck is played in order instead of randomly (respects the 3 cards drawn limit).\n"
 		"  -s: use surge (default is fight).\n"
 		"  -t <num>: set the number of threads, default is 4.\n"
+		"  affinity: pin each thread to its own cpu (when there are no more threads than cpus) and print the placement (Linux; the data is not copied per NUMA node).\n"
+		"  telemetry <num>: every <num> seconds, write the throughput, early stops and evaluated decks as a line of JSON to stderr.\n"
+		"  telemetry-file <file>: append the telemetry to <file> instead of stderr.\n"
+		"  no-cards-cache: load the cards from the XML instead of data/cards_cache.bin (and do not write it).\n"
+		"  deterministic: the same seed gives the same results with any number of threads (comparisons stop early only at fixed numbers of battles).\n"
+		"  flexible-adaptive: like flexible, but drops clearly worse candidates early (flexible-iter is the per-card maximum).\n"
+		"  flexible-cache <num>: cache up to <num> flexible/evaluate decisions per thread and reuse their rollouts, default is 0 (off).\n"
 		"  win:     simulate/optimize for win rate. default for non-raids.\n"
 		"  defense: simulate/optimize for win rate + stall rate. can be used for defending deck or win rate oriented raid simulations.\n"
 		"  raid:    simulate/optimize for average raid damage (ARD). default for raids.\n"
@@ -1541,6 +2190,10 @@ void usage(int argc, char** argv)
 		"  -o=<filename>: restrict to the owned cards listed in <filename>.\n"
 		"  fund <num>: invest <num> SP to upgrade cards.\n"
 		"  target <num>: stop as soon as the score reaches <num>.\n"
+		"  sprt <alpha> <beta>: stop comparing a deck as soon as a sequential test decides it is better (false accept rate <alpha>) or not (false reject rate <beta>).\n"
+		"  sprt-delta <num>: half width of the sequential test's indifference zone around the score to beat, as a fraction of the max score, default is 0.02.\n"
+		"  speculative <num>: climb/beam: sim the next <num> card candidates at once and keep the first one that improves the deck, default is 1 (off).\n"
+		"  crn: common random numbers: battle #i of every deck gets the same seeds, and a candidate is compared battle by battle with the best deck.\n"
 		"\n"
 		"Operations:\n"
 		"  sim <num>: simulate <num> battles to evaluate a deck.\n"
@@ -1709,9 +2362,47 @@ bool parse_bge(
 	return true;
 }
 
-FinalResults<long double> run(int argc, char** argv)
+void load_data(TuoData& data)
 {
-	FinalResults<long double> fr;
+	const std::string& prefix(data.prefix);
+	Cards& all_cards(data.all_cards);
+	Decks& decks(data.decks);
+	std::vector<std::string> card_sections;
+	for (unsigned section = 1; boost::filesystem::exists(prefix+"data/cards_section_" + to_string(section) + ".xml"); ++ section)
+	{
+		card_sections.push_back(prefix+"data/cards_section_" + to_string(section) + ".xml");
+	}
+	std::vector<std::string> cards_sources{prefix+"data/skills_set.xml", prefix+"data/levels.xml"};
+	cards_sources.insert(cards_sources.end(), card_sections.begin(), card_sections.end());
+	const std::string cards_cache_filename(prefix+"data/cards_cache.bin");
+	if (!use_cards_cache || !load_cards_cache(all_cards, cards_cache_filename, cards_sources))
+	{
+		load_skills_set_xml(all_cards, prefix+"data/skills_set.xml", true);
+		load_cards_xml_sections(all_cards, card_sections);
+		all_cards.organize();
+		load_levels_xml(all_cards, prefix+"data/levels.xml", true);
+		all_cards.fix_dominion_recipes();
+		if (use_cards_cache && !all_cards.all_cards.empty())
+		{
+			save_cards_cache(all_cards, cards_cache_filename, cards_sources);
+		}
+	}
+	for (const auto & suffix: data.fn_suffix_list)
+	{
+		load_decks_xml(decks, all_cards, prefix+"data/missions" + suffix + ".xml", prefix+"data/raids" + suffix + ".xml", suffix.empty());
+		load_recipes_xml(all_cards, prefix+"data/fusion_recipes_cj2" + suffix + ".xml", suffix.empty());
+		read_card_abbrs(all_cards, prefix+"data/cardabbrs" + suffix + ".txt");
+	}
+	for (const auto & suffix: data.fn_suffix_list)
+	{
+		load_custom_decks(decks, all_cards, prefix+"data/customdecks" + suffix + ".txt");
+	}
+	read_bge_aliases(data.bge_aliases, prefix+"data/bges.txt");
+}
+
+FinalResults<long double> run(int argc, char** argv, TuoData* data)
+{
+	FinalResults<long double> fr{};
 	opt_num_threads= 4;
 	DeckStrategy::DeckStrategy opt_your_strategy(DeckStrategy::random);
 	DeckStrategy::DeckStrategy opt_enemy_strategy(DeckStrategy::random);
@@ -1974,10 +2665,34 @@ FinalResults<long double> run(int argc, char** argv)
 		{
 			opt_your_strategy = DeckStrategy::flexible;
 		}
+		else if (strcmp(argv[argIndex], "flexible-adaptive") == 0 || strcmp(argv[argIndex], "flex-adaptive") == 0)
+		{
+			opt_your_strategy = DeckStrategy::flexible_adaptive;
+		}
+		else if (strcmp(argv[argIndex], "deterministic") == 0)
+		{
+			use_deterministic = true;
+		}
 		else if (strcmp(argv[argIndex], "flexible-iter") == 0)
 		{
 			if(check_input_amount(argc,argv,argIndex,1))exit(1);
 			flexible_iter = atoi(argv[argIndex+1]);
+			if (flexible_iter == 0)
+			{
+				input_error("flexible-iter: expect at least 1 rollout");
+			}
+			argIndex += 1;
+		}
+		else if (strcmp(argv[argIndex], "speculative") == 0)
+		{
+			if(check_input_amount(argc,argv,argIndex,1))exit(1);
+			climb_speculative = atoi(argv[argIndex+1]);
+			argIndex += 1;
+		}
+		else if (strcmp(argv[argIndex], "flexible-cache") == 0)
+		{
+			if(check_input_amount(argc,argv,argIndex,1))exit(1);
+			flexible_cache_size = atoi(argv[argIndex+1]);
 			argIndex += 1;
 		}
 		else if (strcmp(argv[argIndex], "flexible-turn") == 0)
@@ -2022,6 +2737,10 @@ FinalResults<long double> run(int argc, char** argv)
 		{
 			opt_enemy_strategy = DeckStrategy::flexible;
 		}
+		else if (strcmp(argv[argIndex], "enemy:flexible-adaptive") == 0)
+		{
+			opt_enemy_strategy = DeckStrategy::flexible_adaptive;
+		}
 		else if (strcmp(argv[argIndex], "enemy:ordered") == 0)
 		{
 			opt_enemy_strategy = DeckStrategy::ordered;
@@ -2057,6 +2776,26 @@ FinalResults<long double> run(int argc, char** argv)
 #endif
 			argIndex += 1;
 		}
+		else if (strcmp(argv[argIndex], "affinity") == 0)
+		{
+			use_affinity = true;
+		}
+		else if (strcmp(argv[argIndex], "telemetry") == 0)
+		{
+			if(check_input_amount(argc,argv,argIndex,1))exit(1);
+			telemetry_interval = atoi(argv[argIndex+1]);
+			argIndex += 1;
+		}
+		else if (strcmp(argv[argIndex], "telemetry-file") == 0)
+		{
+			if(check_input_amount(argc,argv,argIndex,1))exit(1);
+			telemetry_file = argv[argIndex+1];
+			argIndex += 1;
+		}
+		else if (strcmp(argv[argIndex], "no-cards-cache") == 0)
+		{
+			use_cards_cache = false;
+		}
 		else if (strcmp(argv[argIndex], "target") == 0)
 		{
 			if(check_input_amount(argc,argv,argIndex,1))exit(1);
@@ -2095,6 +2834,27 @@ FinalResults<long double> run(int argc, char** argv)
 			confidence_level = atof(argv[argIndex+1]);
 			argIndex += 1;
 		}
+		else if (strcmp(argv[argIndex], "sprt") == 0)
+		{
+			if(check_input_amount(argc,argv,argIndex,2))exit(1);
+			sprt_alpha = atof(argv[argIndex+1]);
+			sprt_beta = atof(argv[argIndex+2]);
+			if (!(sprt_alpha > 0 && sprt_alpha < 1 && sprt_beta > 0 && sprt_beta < 1))
+			{
+				input_error("sprt: error rates must be in (0, 1)");
+			}
+			argIndex += 2;
+		}
+		else if (strcmp(argv[argIndex], "sprt-delta") == 0)
+		{
+			if(check_input_amount(argc,argv,argIndex,1))exit(1);
+			sprt_delta = atof(argv[argIndex+1]);
+			argIndex += 1;
+		}
+		else if (strcmp(argv[argIndex], "crn") == 0)
+		{
+			use_crn = true;
+		}
 		else if (strcmp(argv[argIndex], "+so") == 0)
 		{
 			simplify_output = true;
@@ -2396,34 +3156,41 @@ FinalResults<long double> run(int argc, char** argv)
 
 #ifdef _OPENMP
 	opt_num_threads = omp_get_max_threads();
+	if (use_affinity)
+	{
+		std::cerr << "WARNING: affinity is ignored with OpenMP (use OMP_PROC_BIND / OMP_PLACES)" << std::endl;
+	}
 #endif
+	if (use_deterministic && (flexible_cache_size > 0))
+	{
+		// the decisions cached depend on the battles each thread has played
+		std::cerr << "WARNING: flexible-cache is turned off in deterministic mode" << std::endl;
+		flexible_cache_size = 0;
+	}
 
-	Cards all_cards;
-	Decks decks;
-	std::unordered_map<std::string, std::string> bge_aliases;
-	load_skills_set_xml(all_cards, prefix+"data/skills_set.xml", true);
-	for (unsigned section = 1;
-			load_cards_xml(all_cards, prefix+"data/cards_section_" + to_string(section) + ".xml", false);
-			++ section);
-	all_cards.organize();
-	load_levels_xml(all_cards, prefix+"data/levels.xml", true);
-	all_cards.fix_dominion_recipes();
-	for (const auto & suffix: fn_suffix_list)
+	std::unique_ptr<TuoData> own_data;
+	if ((data == nullptr) || (data->prefix != prefix) || (data->fn_suffix_list != fn_suffix_list))
 	{
-		load_decks_xml(decks, all_cards, prefix+"data/missions" + suffix + ".xml", prefix+"data/raids" + suffix + ".xml", suffix.empty());
-		load_recipes_xml(all_cards, prefix+"data/fusion_recipes_cj2" + suffix + ".xml", suffix.empty());
-		read_card_abbrs(all_cards, prefix+"data/cardabbrs" + suffix + ".txt");
+		if (data != nullptr)
+		{
+			std::cerr << "WARNING: prefix/suffixes differ from the loaded data, loading them again" << std::endl;
+		}
+		own_data.reset(new TuoData);
+		own_data->prefix = prefix;
+		own_data->fn_suffix_list = fn_suffix_list;
+		load_data(*own_data);
+		data = own_data.get();
 	}
+	Cards& all_cards(data->all_cards);
+	Decks& decks(data->decks);
+	const std::unordered_map<std::string, std::string>& bge_aliases(data->bge_aliases);
 	for (const auto & suffix: fn_suffix_list)
 	{
-		load_custom_decks(decks, all_cards, prefix+"data/customdecks" + suffix + ".txt");
 		map_keys_to_set(read_custom_cards(all_cards, prefix+"data/allowed_candidates" + suffix + ".txt", false), allowed_candidates);
 		map_keys_to_set(read_custom_cards(all_cards, prefix+"data/disallowed_candidates" + suffix + ".txt", false), disallowed_candidates);
 		map_keys_to_set(read_custom_cards(all_cards, prefix+"data/disallowed_recipes" + suffix + ".txt", false), disallowed_recipes);
 	}
 
-	read_bge_aliases(bge_aliases,prefix+ "data/bges.txt");
-
 	fill_skill_table();
 
 	if (opt_do_optimization and use_owned_cards)
@@ -3003,6 +3770,7 @@ FinalResults<long double> run(int argc, char** argv)
 					       EvaluatedResults results = { EvaluatedResults::first_type(enemy_decks.size()*your_decks.size()), 0 };
 					       results = p.evaluate(std::get<0>(op), results);
 					       print_results(results, p.factors);
+					       p.print_decision_stats();
 					       fr = compute_score(results,p.factors);
 					       print_sim_card_values(your_deck,p,std::get<0>(op));
 					       break;
@@ -3121,6 +3889,10 @@ int main(int argc,char** argv)
 		std::cout << "Tyrant Unleashed Optimizer " << TYRANT_OPTIMIZER_VERSION << std::endl;
 		return 0;
 	}
+	if (argc >= 2 && strcmp(argv[1], "daemon") == 0)
+	{
+		return run_daemon(argc, argv);
+	}
 	if (argc <= 2)
 	{
 		usage(argc, argv);
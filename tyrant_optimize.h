@@ -1,9 +1,15 @@
 #include "deck.h"
+#include "cards.h"
+#include <atomic>
 #include <boost/thread/barrier.hpp>
 #include <boost/thread/mutex.hpp>
 #include <iostream>
 #include <boost/thread/thread.hpp>
 #include <chrono>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <memory>
 // OpenMP Header
 #ifdef _OPENMP
 #include <omp.h>
@@ -41,6 +47,9 @@ namespace tuo {
 	EXTERN long double target_score;
 	EXTERN long double min_increment_of_score;
 	EXTERN long double confidence_level;
+	EXTERN long double sprt_alpha;
+	EXTERN long double sprt_beta;
+	EXTERN long double sprt_delta;
 	EXTERN bool use_top_level_card;
 	EXTERN bool use_top_level_commander;
 	EXTERN bool mode_open_the_deck;
@@ -54,9 +63,17 @@ namespace tuo {
 	EXTERN bool show_ci;
 	EXTERN bool use_harmonic_mean;
 	EXTERN unsigned iterations_multiplier;
+	EXTERN unsigned climb_speculative;
+	EXTERN bool use_crn;
+	EXTERN bool use_deterministic;
+	EXTERN bool use_affinity;
+	EXTERN unsigned telemetry_interval; // seconds, 0: no telemetry
+	EXTERN std::string telemetry_file; // empty: stderr
+	EXTERN bool use_cards_cache; // data/cards_cache.bin
 	EXTERN unsigned sim_seed;
 	EXTERN unsigned flexible_iter;
 	EXTERN unsigned flexible_turn;
+	EXTERN unsigned flexible_cache_size;
 	EXTERN unsigned eval_iter;
 	EXTERN unsigned eval_turn;
 	EXTERN Requirement requirement;
@@ -101,40 +118,225 @@ namespace tuo {
 #endif
 }
 
+// sums of the paired differences (deck - incumbent) of the battles both decks have played (see CrnRun)
+struct PairedSums
+{
+	unsigned pairs;
+	double sum;
+	double sq_sum;
+};
+
+// a run under common random numbers (use_crn): the score of every battle of the deck simmed, by battle index,
+// to be paired with the same battle of the incumbent (see Process::set_crn_incumbent()). The battles played are
+// flagged apart (not with a NaN score: -Ofast folds std::isnan()), one byte each as threads record theirs at once.
+struct CrnRun
+{
+	std::vector<double> scores;
+	std::vector<char> recorded;
+	const std::vector<double>* incumbent_scores;
+	const std::vector<bool>* incumbent_recorded;
+
+	void record(unsigned i, double score)
+	{
+		scores[i] = score;
+		recorded[i] = true;
+	}
+
+	// add the differences of battles [first, last) that the incumbent has played too
+	void add_pairs(unsigned first, unsigned last, PairedSums& sums) const
+	{
+		last = std::min<unsigned>(last, incumbent_recorded->size());
+		for (unsigned i(first); i < last; ++i)
+		{
+			if (!(*incumbent_recorded)[i])
+			{ continue; }
+			double diff = scores[i] - (*incumbent_scores)[i];
+			++ sums.pairs;
+			sums.sum += diff;
+			sums.sq_sum += diff * diff;
+		}
+	}
+};
+
+// early stop of compare() in deterministic mode (use_deterministic): the chunks of a run are reduced in battle
+// order and the stop is decided at chunk boundaries on the battles before them, so that the battles counted
+// depend neither on the number of threads nor on their timing (chunks past the stop are dropped)
+struct OrderedReduction
+{
+	unsigned num_chunks;
+	unsigned num_results;
+	std::vector<Results<uint64_t>> chunk_results; // [chunk * num_results + index]
+	std::vector<unsigned> chunk_battles;
+	std::vector<PairedSums> chunk_pairs;
+	std::unique_ptr<std::atomic<bool>[]> chunk_done;
+	unsigned chunk_done_size;
+	boost::mutex mutex; // guards the reduction below
+	unsigned num_reduced_chunks;
+	std::atomic<bool> stopped;
+	std::vector<Results<uint64_t>> results;
+	unsigned battles;
+	PairedSums pairs;
+
+	OrderedReduction() : num_chunks(0), num_results(0), chunk_done_size(0), num_reduced_chunks(0), stopped(false), battles(0), pairs() {}
+
+	void reset(unsigned num_chunks_, unsigned num_results_)
+	{
+		num_chunks = num_chunks_;
+		num_results = num_results_;
+		chunk_results.resize(num_chunks * num_results);
+		chunk_battles.resize(num_chunks);
+		chunk_pairs.resize(num_chunks);
+		if (chunk_done_size < num_chunks)
+		{
+			chunk_done.reset(new std::atomic<bool>[num_chunks]);
+			chunk_done_size = num_chunks;
+		}
+		for (unsigned chunk(0); chunk < num_chunks; ++chunk)
+		{ chunk_done[chunk] = false; }
+		num_reduced_chunks = 0;
+		stopped = false;
+		results.assign(num_results, Results<uint64_t>());
+		battles = 0;
+		pairs = PairedSums{0, 0, 0};
+	}
+
+	// a thread is done with a chunk (each chunk is put once)
+	void put(unsigned chunk, const std::vector<Results<uint64_t>>& chunk_results_, unsigned chunk_battles_, const PairedSums& chunk_pairs_)
+	{
+		std::copy(chunk_results_.begin(), chunk_results_.begin() + num_results, chunk_results.begin() + chunk * num_results);
+		chunk_battles[chunk] = chunk_battles_;
+		chunk_pairs[chunk] = chunk_pairs_;
+		chunk_done[chunk].store(true, std::memory_order_release);
+	}
+
+	// reduce the chunks done so far in order, checking can_stop(results, battles, pairs) after each one;
+	// with wait = false, let a thread already at it do it; true once stopped
+	template <typename CanStop>
+	bool reduce(CanStop can_stop, bool wait)
+	{
+		boost::unique_lock<boost::mutex> lock(mutex, boost::defer_lock);
+		if (wait)
+		{ lock.lock(); }
+		else if (!lock.try_lock())
+		{ return stopped; }
+		while (!stopped && (num_reduced_chunks < num_chunks) && chunk_done[num_reduced_chunks].load(std::memory_order_acquire))
+		{
+			const unsigned chunk(num_reduced_chunks ++);
+			for (unsigned index(0); index < num_results; ++index)
+			{ results[index] += chunk_results[chunk * num_results + index]; }
+			battles += chunk_battles[chunk];
+			pairs.pairs += chunk_pairs[chunk].pairs;
+			pairs.sum += chunk_pairs[chunk].sum;
+			pairs.sq_sum += chunk_pairs[chunk].sq_sum;
+			if (can_stop(results, battles, pairs))
+			{ stopped = true; }
+		}
+		return stopped;
+	}
+};
+
+// a deck evaluated by Process::evaluate_batch(): simmed up to the batch's num_iterations like
+// evaluate(), or like compare() (stopped once it cannot beat *best_results) when best_results is set
+struct BatchCandidate
+{
+	std::shared_ptr<Deck> deck; // simmed in place of Process::your_decks[0]
+	EvaluatedResults* results;
+	const FinalResults<long double>* best_results;
+};
+
+// evaluate_batch() state of a candidate: threads claim chunks of its battles and merge them into its results
+struct BatchRun
+{
+	const BatchCandidate* candidate;
+	unsigned candidate_index; // in the evaluate_batch() candidates
+	uint64_t run_seed;
+	unsigned first_battle;
+	unsigned num_battles;
+	unsigned chunk_size;
+	std::atomic<unsigned> claimed_battles;
+	std::atomic<bool> stop;
+	boost::mutex mutex; // guards *candidate->results
+	CrnRun* crn_run;
+	PairedSums pairs; // guarded by mutex
+	bool ordered; // deterministic mode: the results are reduced in ordered_results (see OrderedReduction)
+	OrderedReduction ordered_results;
+};
+
+// live statistics of a Process (telemetry option): a thread of its own writes them as a line of JSON
+// every telemetry_interval seconds; only atomics are shared with it. Process has none without the option.
+struct Telemetry
+{
+	std::chrono::steady_clock::time_point start;
+	std::atomic<uint64_t> compares{0}, early_stops{0}, compare_sims{0};
+	// lookups of the decks' results in the evaluated decks of the algorithms (hits: found there)
+	std::atomic<uint64_t> deck_lookups{0}, deck_hits{0}, deck_entries{0}, deck_bytes{0};
+	std::ofstream file;
+	std::ostream* out;
+	boost::thread* thread;
+	// at the previous report (the rates are since then)
+	std::chrono::steady_clock::time_point last_time;
+	std::vector<uint64_t> last_battles, last_wait_ns;
+};
+
 namespace proc {
-  EXTERN volatile unsigned thread_num_iterations; // written by threads
-  EXTERN EvaluatedResults *thread_results; // written by threads
+  EXTERN volatile unsigned thread_num_iterations; // battles of the current run
+  EXTERN EvaluatedResults *thread_results; // read-only during a run (threads' totals are merged at the barrier)
   EXTERN volatile const FinalResults<long double> *thread_best_results;
   EXTERN volatile bool thread_compare;
   EXTERN volatile bool thread_compare_stop; // written by threads
+  EXTERN uint64_t thread_run_seed; // battle #i of the current run is seeded from (thread_run_seed, i)
+  EXTERN unsigned thread_next_battle; // index of the first battle of the current run
+  EXTERN std::atomic<unsigned> thread_claimed_battles; // written by threads: battles of the current run claimed so far
+  EXTERN unsigned thread_chunk_size; // battles claimed at once
+  EXTERN std::vector<BatchRun> *thread_batch_runs; // set during evaluate_batch()
+  EXTERN const std::function<bool(unsigned)> *thread_batch_accepted; // set during evaluate_batch() of speculative moves
+  EXTERN OrderedReduction *thread_ordered; // set during a compare() run of the deterministic mode
+  EXTERN CrnRun *thread_crn_run; // set during a run under common random numbers: scores of the battles to record
   EXTERN volatile bool destroy_threads;
 }
 
 using namespace tuo;
 using namespace proc;
 
+// the data files run() reads for a prefix and suffixes (cards, missions, raids, recipes, abbreviations,
+// custom decks, BGE aliases): load_data() loads them once for any number of runs (see daemon.h);
+// a run changes them (decks added, disallowed recipes erased): the daemon gives every run a fork()ed copy,
+// sim_test shares them between its runs (see test_data()).
+struct TuoData
+{
+	std::string prefix;
+	std::vector<std::string> fn_suffix_list{"",};
+	Cards all_cards;
+	Decks decks;
+	std::unordered_map<std::string, std::string> bge_aliases;
+};
+
 struct SimulationData;
 class Process;
 // some shared functions
 FinalResults<long double> compute_score(const EvaluatedResults& results, std::vector<long double>& factors);
+bool compare_can_stop(unsigned trials, long double successes, const volatile FinalResults<long double>& best_results);
+bool compare_can_stop(const PairedSums& pairs);
+bool compare_can_stop(const EvaluatedResults& results, const std::vector<Results<uint64_t>>& run_results, unsigned run_battles,
+		const PairedSums& run_pairs, const std::vector<long double>& factors, const volatile FinalResults<long double>& best_results);
 unsigned get_deck_cost(const Deck* deck);
+Deck* find_deck(Decks& decks, const Cards& all_cards, std::string deck_name);
+void thread_run(SimulationData& sim, const Process& p, unsigned thread_id);
+void pin_threads(const std::vector<boost::thread*>& threads);
 void thread_evaluate(boost::barrier& main_barrier,
-		boost::mutex& shared_mutex,
 		SimulationData& sim,
 		const Process& p,
 		unsigned thread_id);
 #ifndef TEST
 int main(int argc, char** argv);
 #endif
-FinalResults<long double> run(int argc, char** argv);
+void load_data(TuoData& data);
+FinalResults<long double> run(int argc, char** argv, TuoData* data = nullptr); // data: nullptr to load it
 void init();
 bool is_timeout_reached();
 bool valid_deck(Deck* your_deck);
 std::vector<std::vector<const Card*>> get_candidate_lists(Process& proc);
 std::string alpha_dominion_cost(const Card* dom_card);
-#ifdef _OPENMP
-std::vector<Results<uint64_t>> merge(std::vector<Results<uint64_t>> out, std::vector<Results<uint64_t>> in);
-#endif
 // some print functions
 void print_score_info(const EvaluatedResults& results, std::vector<long double>& factors);
 void print_results(const EvaluatedResults& results, std::vector<long double>& factors);
@@ -146,7 +348,8 @@ void print_upgraded_cards(Deck* deck);
 
 struct SimulationData
 {
-	std::mt19937 re;
+	RandomEngine re;
+	RandomEngine battle_re; // reseeded for every battle
 	const Cards& cards;
 	const Decks& decks;
 	std::vector<std::shared_ptr<Deck>> your_decks;
@@ -160,6 +363,23 @@ struct SimulationData
 #endif
 	std::array<signed short, PassiveBGE::num_passive_bges> your_bg_effects, enemy_bg_effects;
 	std::vector<SkillSpec> your_bg_skills, enemy_bg_skills;
+	// per-battle state is reused (see set_decks()): once warm, evaluate() does not allocate
+	std::vector<std::shared_ptr<Field>> fields;  // [your hand][enemy hand]
+	std::vector<Results<uint64_t>> results;
+	DecisionCache decision_cache;
+	std::vector<std::string> decision_cache_decks; // hashes of the decks of the decisions cached
+	// this thread's share of the current run (see thread_evaluate()): only the owner writes it,
+	// once per claimed chunk; Process merges it into the run results at the barrier.
+	// The points are also published (atomically) for the early-stop check of compare().
+	std::vector<Results<uint64_t>> run_results;
+	unsigned run_battles;
+	std::vector<std::atomic<uint64_t>> run_published_points;
+	std::atomic<unsigned> run_published_battles;
+	PairedSums run_pairs; // common random numbers (see CrnRun): published alike for compare()
+	std::atomic<unsigned> run_published_pairs;
+	std::atomic<double> run_published_pair_sum, run_published_pair_sq_sum;
+	// telemetry (only counted with the option): battles played and time spent waiting at the barriers
+	std::atomic<uint64_t> telemetry_battles, telemetry_wait_ns;
 
 	SimulationData(unsigned seed, const Cards& cards_, const Decks& decks_, unsigned num_your_decks_,unsigned num_enemy_decks_, std::vector<long double> factors_, gamemode_t gamemode_,
 #ifndef NQUEST
@@ -170,6 +390,7 @@ struct SimulationData
 			std::vector<SkillSpec>& your_bg_skills_,
 			std::vector<SkillSpec>& enemy_bg_skills_) :
 		re(seed),
+		battle_re(seed),
 		cards(cards_),
 		decks(decks_),
 		your_decks(num_your_decks_),
@@ -182,7 +403,18 @@ struct SimulationData
 		your_bg_effects(your_bg_effects_),
 		enemy_bg_effects(enemy_bg_effects_),
 		your_bg_skills(your_bg_skills_),
-		enemy_bg_skills(enemy_bg_skills_)
+		enemy_bg_skills(enemy_bg_skills_),
+		decision_cache(flexible_cache_size),
+		run_results(num_your_decks_ * num_enemy_decks_),
+		run_battles(0),
+		run_published_points(num_your_decks_ * num_enemy_decks_),
+		run_published_battles(0),
+		run_pairs(),
+		run_published_pairs(0),
+		run_published_pair_sum(0),
+		run_published_pair_sq_sum(0),
+		telemetry_battles(0),
+		telemetry_wait_ns(0)
 		{
 			for (size_t i = 0; i < num_your_decks_; ++i)
 			{
@@ -201,7 +433,13 @@ struct SimulationData
 	}
 
   void set_decks(std::vector<Deck*> const your_decks_, std::vector<Deck*> const & enemy_decks_);
-  inline std::vector<Results<uint64_t>> evaluate();
+  void set_your_deck(const Deck& your_deck);
+  void check_decision_cache();
+  void evaluate_range(uint64_t run_seed, unsigned first_battle, unsigned num_battles, std::vector<Results<uint64_t>>& totals, CrnRun* crn_run = nullptr);
+  std::shared_ptr<Field> make_field(RandomEngine& re, Hand& your_hand, Hand& enemy_hand);
+  inline void reset_hands(RandomEngine& re, uint64_t run_seed, unsigned battle_index, unsigned res_index, Hand& your_hand, Hand& enemy_hand);
+  inline double battle_score(const Results<uint64_t>* battle_results) const;
+  inline const std::vector<Results<uint64_t>>& evaluate(uint64_t run_seed, unsigned battle_index);
 };
 class Process
 {
@@ -210,7 +448,6 @@ public:
     std::vector<boost::thread*> threads;
     std::vector<SimulationData*> threads_data;
     boost::barrier main_barrier;
-    boost::mutex shared_mutex;
     const Cards& cards;
     const Decks& decks;
     const std::vector<Deck*> your_decks;
@@ -222,6 +459,19 @@ public:
     #endif
     std::array<signed short, PassiveBGE::num_passive_bges> your_bg_effects, enemy_bg_effects;
     std::vector<SkillSpec> your_bg_skills, enemy_bg_skills;
+    uint64_t seed;
+    unsigned num_runs;
+    // battles saved by comparisons (compare() and evaluate_batch() candidates with best_results) stopped early by sprt,
+    // not yet taken by take_sprt_skipped_simulations()
+    unsigned long sprt_skipped_simulations;
+    // common random numbers (use_crn): the incumbent the comparisons are paired with (see set_crn_incumbent())
+    // and the score of each of its battles, and the battles recorded by the latest runs by deck results
+    const EvaluatedResults* crn_incumbent;
+    std::vector<double> crn_incumbent_scores;
+    std::vector<bool> crn_incumbent_recorded;
+    std::unordered_map<const EvaluatedResults*, CrnRun> crn_runs;
+    OrderedReduction ordered_run; // compare() in deterministic mode
+    std::unique_ptr<Telemetry> telemetry;
   public:
     Process(unsigned num_threads_, const Cards& cards_, const Decks& decks_, std::vector<Deck*> your_decks_, std::vector<Deck*> enemy_decks_, std::vector<long double> factors_, gamemode_t gamemode_,
 #ifndef NQUEST
@@ -244,10 +494,13 @@ public:
 			your_bg_effects(your_bg_effects_),
 			enemy_bg_effects(enemy_bg_effects_),
 			your_bg_skills(your_bg_skills_),
-			enemy_bg_skills(enemy_bg_skills_)
+			enemy_bg_skills(enemy_bg_skills_),
+			seed(sim_seed ? sim_seed : static_cast<unsigned>(std::chrono::system_clock::now().time_since_epoch().count() * 2654435761)),  // Knuth multiplicative hash
+			num_runs(0),
+			sprt_skipped_simulations(0),
+			crn_incumbent(nullptr)
 			{
 				destroy_threads = false;
-				unsigned seed(sim_seed ? sim_seed : std::chrono::system_clock::now().time_since_epoch().count() * 2654435761);  // Knuth multiplicative hash
 				if (num_threads_ == 1)
 				{
 					std::cout << "RNG seed " << seed << std::endl;
@@ -260,13 +513,20 @@ public:
 #endif
 								your_bg_effects, enemy_bg_effects, your_bg_skills, enemy_bg_skills));
 #ifndef _OPENMP
-					threads.push_back(new boost::thread(thread_evaluate, std::ref(main_barrier), std::ref(shared_mutex), std::ref(*threads_data.back()), std::ref(*this), i));
+					threads.push_back(new boost::thread(thread_evaluate, std::ref(main_barrier), std::ref(*threads_data.back()), std::ref(*this), i));
 #endif
 				}
+#ifndef _OPENMP
+				if (use_affinity)
+				{ pin_threads(threads); }
+#endif
+				if (telemetry_interval > 0)
+				{ start_telemetry(); }
 			}
 
 		~Process()
 		{
+			stop_telemetry();
 			destroy_threads = true;
 #ifndef _OPENMP
 			main_barrier.wait();
@@ -275,10 +535,37 @@ public:
 			for (auto data: threads_data) { delete(data); }
 		}
 
+    uint64_t next_run_seed();
+    unsigned run_chunk_size(unsigned num_battles) const;
+    void start_run(unsigned num_iterations, EvaluatedResults & evaluated_results);
+    void merge_run(EvaluatedResults & evaluated_results);
+    void print_decision_stats() const;
+    void count_compare(unsigned num_iterations, const EvaluatedResults & evaluated_results);
+    // the battles saved by sprt since the last call (counted by the algorithms as skipped simulations)
+    unsigned long take_sprt_skipped_simulations();
+    void start_telemetry();
+    void stop_telemetry();
+    void report_telemetry();
+    // telemetry: a lookup of a deck's results (entry) in the evaluated decks of an algorithm
+    void count_evaluated_deck(const std::unordered_map<std::string, EvaluatedResults>& evaluated_decks,
+        const std::pair<const std::string, EvaluatedResults>& entry, bool hit)
+    {
+        if (!telemetry) { return; }
+        ++ telemetry->deck_lookups;
+        if (hit) { ++ telemetry->deck_hits; }
+        // estimate: hash node + key + results of every entry (taking this one's sizes), and the buckets
+        telemetry->deck_entries = evaluated_decks.size();
+        telemetry->deck_bytes = evaluated_decks.size() * (sizeof(entry) + 2 * sizeof(void*) + entry.first.capacity()
+            + entry.second.first.capacity() * sizeof(Results<uint64_t>)) + evaluated_decks.bucket_count() * sizeof(void*);
+    }
+    CrnRun* add_crn_run(const EvaluatedResults & evaluated_results, unsigned num_iterations);
+    void set_crn_incumbent(const EvaluatedResults * evaluated_results);
+    long double crn_incumbent_points(unsigned num_battles, long double points) const;
     EvaluatedResults & evaluate(unsigned num_iterations, EvaluatedResults & evaluated_results);
     EvaluatedResults & compare(unsigned num_iterations, EvaluatedResults & evaluated_results, const FinalResults<long double> & best_results);
+    void evaluate_batch(const std::vector<BatchCandidate> & candidates, unsigned num_iterations,
+            const std::function<bool(unsigned)> & accepted = nullptr);
 #ifdef _OPENMP
-		void openmp_evaluate_reduction(EvaluatedResults & evaluated_results);
-    void openmp_compare_reduction(EvaluatedResults & evaluated_results);
+    void openmp_run();
 #endif
 };
@@ -6,7 +6,13 @@
 #include <map>
 #include <stdexcept>
 #include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <sstream>
+#include <vector>
 #include <boost/algorithm/string.hpp>
+#include <boost/thread/thread.hpp>
 #include "rapidxml.hpp"
 #include "card.h"
 #include "cards.h"
@@ -19,11 +25,15 @@
 // mission only and test cards have no set
 using namespace rapidxml;
 
+// where the warnings of the card parsing go: std::cerr, or the buffer of a file parsed by a thread of its own
+// (see load_cards_xml_sections())
+static thread_local std::ostream* card_warnings = &std::cerr;
+
 Skill::Skill skill_name_to_id(const std::string & name)
 {
-    static std::map<std::string, int> skill_map;
-    if (skill_map.empty())
-    {
+    // built once (thread-safe): the card files are parsed concurrently
+    static const std::map<std::string, int> skill_map = []() {
+        std::map<std::string, int> skill_map;
         for (unsigned i(0); i < Skill::num_skills; ++i)
         {
             std::string skill_id = boost::to_lower_copy(skill_names[i]);
@@ -31,7 +41,8 @@ Skill::Skill skill_name_to_id(const std::string & name)
         }
         skill_map["armored"] = skill_map["armor"];  // Special case for Armor: id and name differ
         skill_map["besiege"] = skill_map["mortar"]; // Special case for Mortar: id and name differ
-    }
+        return skill_map;
+    }();
     auto x = skill_map.find(boost::to_lower_copy(name));
     if (x == skill_map.end())
     {
@@ -65,7 +76,7 @@ Skill::Trigger skill_trigger(xml_node<>* skill)
                 return static_cast<Skill::Trigger>(t);
             }
         }
-        std::cerr << "WARNING: unknown skill trigger: " << trigger->value() << std::endl;
+        *card_warnings << "WARNING: unknown skill trigger: " << trigger->value() << std::endl;
     }
     return Skill::Trigger::activate;
 }
@@ -122,7 +133,7 @@ bool parse_file(const std::string & filename, std::vector<char>& buffer, xml_doc
     {
         if (do_warn_on_missing)
         {
-            std::cerr << "WARNING: The file '" << filename << "' does not exist. Proceeding without reading from this file.\n";
+            *card_warnings << "WARNING: The file '" << filename << "' does not exist. Proceeding without reading from this file.\n";
         }
         buffer.resize(1);
         buffer[0] = 0;
@@ -144,8 +155,8 @@ bool parse_file(const std::string & filename, std::vector<char>& buffer, xml_doc
     }
     catch(rapidxml::parse_error& e)
     {
-        std::cerr << "Parse error exception.\n";
-        std::cout << e.what();
+        // buffered with the warnings of the file when parsed by a thread (see load_cards_xml_sections())
+        *card_warnings << "Parse error exception.\n" << e.what();
         throw(e);
     }
 }
@@ -206,12 +217,12 @@ void parse_card_node(Cards& all_cards, Card* card, xml_node<>* card_node)
                         card->m_category = CardCategory::fortress_siege;
                         break;
                     default:
-                        std::cerr << "WARNING: parsing card [" << card->m_id << "]: unsupported fortress_type=" << fort_type_value << std::endl;
+                        *card_warnings << "WARNING: parsing card [" << card->m_id << "]: unsupported fortress_type=" << fort_type_value << std::endl;
                     }
                 }
                 else if ((card->m_id < 2748) || (card->m_id >= 2754)) // except Sky Fortress
                 {
-                    std::cerr << "WARNING: parsing card [" << card->m_id << "]: expected fortress_type node" << std::endl;
+                    *card_warnings << "WARNING: parsing card [" << card->m_id << "]: expected fortress_type node" << std::endl;
                 }
             }
         }
@@ -278,7 +289,7 @@ void parse_card_node(Cards& all_cards, Card* card, xml_node<>* card_node)
     {
         if (card->m_type != CardType::structure)
         {
-            std::cerr << "WARNING: parsing card [" << card->m_id << "]: set 8000 supposes fortresses card that implies type Structure"
+            *card_warnings << "WARNING: parsing card [" << card->m_id << "]: set 8000 supposes fortresses card that implies type Structure"
                 << ", but card has type " << cardtype_names[card->m_type] << std::endl;
         }
 
@@ -360,6 +371,57 @@ bool load_cards_xml(Cards & all_cards, const std::string & filename, bool do_war
     return true;
 }
 
+// cards_section_*.xml: each file is parsed by a thread into a card list of its own, with its warnings buffered;
+// they are then appended to all_cards (and the warnings printed) in file order, up to the first file that
+// load_cards_xml() would have stopped at: the same cards in the same order as one file after the other.
+unsigned load_cards_xml_sections(Cards & all_cards, const std::vector<std::string> & filenames)
+{
+    struct Section
+    {
+        Cards cards;
+        std::ostringstream warnings;
+        bool loaded;
+        std::exception_ptr error;
+    };
+    std::vector<std::unique_ptr<Section>> sections;
+    for (unsigned i(0); i < filenames.size(); ++i) { sections.emplace_back(new Section()); }
+    std::atomic<unsigned> next_section(0);
+    auto parse_sections = [&]() {
+        for (unsigned i; (i = next_section++) < filenames.size(); )
+        {
+            Section& section(*sections[i]);
+            card_warnings = &section.warnings;
+            try
+            {
+                section.loaded = load_cards_xml(section.cards, filenames[i], false);
+            }
+            catch (...)
+            {
+                section.loaded = false;
+                section.error = std::current_exception();
+            }
+            card_warnings = &std::cerr;
+        }
+    };
+    unsigned num_threads = std::max(1u, std::min<unsigned>(filenames.size(), boost::thread::hardware_concurrency()));
+    boost::thread_group threads;
+    for (unsigned i(1); i < num_threads; ++i) { threads.create_thread(parse_sections); }
+    parse_sections();
+    threads.join_all();
+
+    unsigned num_loaded(0);
+    for (auto& section: sections)
+    {
+        std::cerr << section->warnings.str();
+        if (section->error) { std::rethrow_exception(section->error); }
+        if (!section->loaded) { break; }
+        all_cards.all_cards.insert(all_cards.all_cards.end(), section->cards.all_cards.begin(), section->cards.all_cards.end());
+        section->cards.all_cards.clear();
+        ++ num_loaded;
+    }
+    return num_loaded;
+}
+
 void load_skills_set_xml(Cards & all_cards, const std::string & filename, bool do_warn_on_missing)
 {
     std::vector<char> buffer;
@@ -389,6 +451,9 @@ void load_levels_xml(Cards& all_cards, const std::string& filename, bool do_warn
     xml_node<>* root = doc.first_node();
     if (!root) { return; }
 
+    // keyed by the cards of <all_cards>: drop whatever an earlier load (of another Cards) left
+    for (auto& costs: dominion_cost) { for (auto& cost: costs) { cost.clear(); } }
+    for (auto& refunds: dominion_refund) { for (auto& refund: refunds) { refund.clear(); } }
     for (xml_node<>* dfl_node = root->first_node("dominion_fusion_level");
             dfl_node;
             dfl_node = dfl_node->next_sibling("dominion_fusion_level"))
@@ -620,12 +685,52 @@ Deck* read_deck(Decks& decks, const Cards& all_cards, xml_node<>* node, DeckType
     return deck;
 }
 //------------------------------------------------------------------------------
-void read_missions(Decks& decks, const Cards& all_cards, const std::string & filename, bool do_warn_on_missing=true)
+// an XML file kept parsed for the decks read_deck() builds on lookup
+struct XmlFile
 {
     std::vector<char> buffer;
     xml_document<> doc;
-    parse_file(filename.c_str(), buffer, doc, do_warn_on_missing);
-    xml_node<>* root = doc.first_node();
+};
+
+// the names read_deck() adds the decks of <node> with
+std::vector<std::string> read_deck_names(xml_node<>* node, DeckType::DeckType decktype, unsigned id, const std::string& base_deck_name)
+{
+    xml_node<>* levels_node(node->first_node("levels"));
+    unsigned max_level = levels_node ? atoi(levels_node->value()) : 10;
+    std::vector<std::string> deck_names;
+    for (unsigned level = 1; level < max_level; ++ level)
+    {
+        deck_names.push_back(base_deck_name + "-" + to_string(level));
+        deck_names.push_back(decktype_names[decktype] + " #" + to_string(id) + "-" + to_string(level));
+    }
+    deck_names.push_back(base_deck_name);
+    deck_names.push_back(base_deck_name + "-" + to_string(max_level));
+    deck_names.push_back(decktype_names[decktype] + " #" + to_string(id));
+    deck_names.push_back(decktype_names[decktype] + " #" + to_string(id) + "-" + to_string(max_level));
+    return deck_names;
+}
+
+// index the decks of <node> by name: read_deck() once one of them is looked up (see Decks::add_lazy_decks())
+void add_lazy_deck(Decks& decks, const Cards& all_cards, const std::shared_ptr<XmlFile>& file, const std::string & filename,
+        xml_node<>* node, DeckType::DeckType decktype, unsigned id, const std::string& deck_name, const char* kind)
+{
+    decks.add_lazy_decks(read_deck_names(node, decktype, id, deck_name), [&decks, &all_cards, file, filename, node, decktype, id, deck_name, kind]() {
+        try
+        {
+            read_deck(decks, all_cards, node, decktype, id, deck_name);
+        }
+        catch (const std::runtime_error& e)
+        {
+            std::cerr << "WARNING: Failed to parse " << kind << " [" << deck_name << "] in file " << filename << ": [" << e.what() << "]. Skip the " << kind << ".\n";
+        }
+    });
+}
+
+void read_missions(Decks& decks, const Cards& all_cards, const std::string & filename, bool do_warn_on_missing=true)
+{
+    std::shared_ptr<XmlFile> file(std::make_shared<XmlFile>());
+    parse_file(filename.c_str(), file->buffer, file->doc, do_warn_on_missing);
+    xml_node<>* root = file->doc.first_node();
 
     if (!root)
     {
@@ -636,30 +741,20 @@ void read_missions(Decks& decks, const Cards& all_cards, const std::string & fil
         mission_node;
         mission_node = mission_node->next_sibling("mission"))
     {
-        std::vector<unsigned> card_ids;
         xml_node<>* id_node(mission_node->first_node("id"));
         assert(id_node);
         unsigned id(id_node ? atoi(id_node->value()) : 0);
         xml_node<>* name_node(mission_node->first_node("name"));
         std::string deck_name{name_node->value()};
-        try
-        {
-            read_deck(decks, all_cards, mission_node, DeckType::mission, id, deck_name);
-        }
-        catch (const std::runtime_error& e)
-        {
-            std::cerr << "WARNING: Failed to parse mission [" << deck_name << "] in file " << filename << ": [" << e.what() << "]. Skip the mission.\n";
-            continue;
-        }
+        add_lazy_deck(decks, all_cards, file, filename, mission_node, DeckType::mission, id, deck_name, "mission");
     }
 }
 //------------------------------------------------------------------------------
 void read_raids(Decks& decks, const Cards& all_cards, const std::string & filename, bool do_warn_on_missing=true)
 {
-    std::vector<char> buffer;
-    xml_document<> doc;
-    parse_file(filename.c_str(), buffer, doc, do_warn_on_missing);
-    xml_node<>* root = doc.first_node();
+    std::shared_ptr<XmlFile> file(std::make_shared<XmlFile>());
+    parse_file(filename.c_str(), file->buffer, file->doc, do_warn_on_missing);
+    xml_node<>* root = file->doc.first_node();
 
     if (!root)
     {
@@ -675,15 +770,7 @@ void read_raids(Decks& decks, const Cards& all_cards, const std::string & filena
         unsigned id(id_node ? atoi(id_node->value()) : 0);
         xml_node<>* name_node(raid_node->first_node("name"));
         std::string deck_name{name_node->value()};
-        try
-        {
-            read_deck(decks, all_cards, raid_node, DeckType::raid, id, deck_name);
-        }
-        catch (const std::runtime_error& e)
-        {
-            std::cerr << "WARNING: Failed to parse raid [" << deck_name << "] in file " << filename << ": [" << e.what() << "]. Skip the raid.\n";
-            continue;
-        }
+        add_lazy_deck(decks, all_cards, file, filename, raid_node, DeckType::raid, id, deck_name, "raid");
     }
 
     for (xml_node<>* campaign_node = root->first_node("campaign");
@@ -696,15 +783,7 @@ void read_raids(Decks& decks, const Cards& all_cards, const std::string & filena
             name_node;
             name_node = name_node->next_sibling("name"))
         {
-            try
-            {
-                read_deck(decks, all_cards, campaign_node, DeckType::campaign, id, name_node->value());
-            }
-            catch (const std::runtime_error& e)
-            {
-                std::cerr << "WARNING: Failed to parse campaign [" << name_node->value() << "] in file " << filename << ": [" << e.what() << "]. Skip the campaign.\n";
-                continue;
-            }
+            add_lazy_deck(decks, all_cards, file, filename, campaign_node, DeckType::campaign, id, name_node->value(), "campaign");
         }
     }
 }
@@ -2,6 +2,7 @@
 #define XML_H_INCLUDED
 
 #include <string>
+#include <vector>
 #include "tyrant.h"
 
 class Cards;
@@ -10,6 +11,7 @@ class Achievement;
 
 Skill::Skill skill_name_to_id(const std::string & name);
 bool load_cards_xml(Cards & all_cards, const std::string & filename, bool do_warn_on_missing);
+unsigned load_cards_xml_sections(Cards & all_cards, const std::vector<std::string> & filenames);
 void load_skills_set_xml(Cards & all_cards, const std::string & filename, bool do_warn_on_missing);
 void load_levels_xml(Cards& all_cards, const std::string& filename, bool do_warn_on_missing);
 void load_decks_xml(Decks& decks, const Cards& all_cards, const std::string & mission_filename, const std::string & raid_filename, bool do_warn_on_missing);